@@ -0,0 +1,46 @@
+# ForwardHeaders.cmake : make the MT5 API headers includable on Linux.
+#
+# The SDK includes its own headers with Windows path separators, e.g.
+# #include "Common\MT5APIConstants.h". GCC takes the backslash literally,
+# so for every such include we generate a forwarding header whose file
+# name is the literal include string (backslashes are valid in Linux file
+# names). It includes the real header, or a portable replacement from
+# linux/include/mt5api when one exists.
+#
+# Usage:
+#   mt5api_generate_forwarders(OUTPUT_DIR <dir> SDK_DIR <dir> REPLACEMENT_DIR <dir>)
+
+function(mt5api_generate_forwarders)
+  cmake_parse_arguments(ARG "" "OUTPUT_DIR;SDK_DIR;REPLACEMENT_DIR" "" ${ARGN})
+
+  file(MAKE_DIRECTORY "${ARG_OUTPUT_DIR}")
+  file(GLOB_RECURSE sdk_headers "${ARG_SDK_DIR}/*.h")
+  foreach(header ${sdk_headers})
+    file(STRINGS "${header}" includes REGEX "^#include \"[^\"]*\\\\[^\"]*\"")
+    get_filename_component(header_dir "${header}" DIRECTORY)
+    foreach(include ${includes})
+      string(REGEX REPLACE "^#include \"([^\"]*)\".*$" "\\1" include_name "${include}")
+      string(REPLACE "\\" "/" include_path "${include_name}")
+      get_filename_component(include_file "${include_path}" NAME)
+
+      if(EXISTS "${ARG_REPLACEMENT_DIR}/${include_file}")
+        set(target "${ARG_REPLACEMENT_DIR}/${include_file}")
+      else()
+        get_filename_component(target "${header_dir}/${include_path}" ABSOLUTE)
+      endif()
+
+      set(content "#include \"${target}\"\n")
+      set(forwarder "${ARG_OUTPUT_DIR}/${include_name}")
+      set(previous "")
+      if(EXISTS "${forwarder}")
+        file(READ "${forwarder}" previous)
+      endif()
+      if(NOT previous STREQUAL content)
+        # file(WRITE) would turn the backslashes into directories, so the
+        # forwarder is written under a temporary name and renamed.
+        file(WRITE "${ARG_OUTPUT_DIR}/forwarder.tmp" "${content}")
+        file(RENAME "${ARG_OUTPUT_DIR}/forwarder.tmp" "${forwarder}")
+      endif()
+    endforeach()
+  endforeach()
+endfunction()
@@ -0,0 +1,72 @@
+# GenerateStubs.cmake : generate default implementations of MT5 API
+# interfaces for the Linux host build.
+#
+# Every interface of "MT5APIServer.h" is an abstract class with hundreds
+# of pure virtual methods. The fake server only implements a handful of
+# them, so for each requested interface IMTxxx we generate a class
+# StubMTxxx, which implements every pure virtual method with a default
+# body (MTAPIRES methods return MT_RET_ERR_NOTIMPLEMENT, other methods
+# return a value-initialized result). Fakes derive from the stub class
+# and override only what they need.
+#
+# Usage:
+#   mt5api_generate_stubs(OUTPUT <header> SDK_DIR <dir> INTERFACES <names>...)
+
+function(mt5api_generate_stubs)
+  cmake_parse_arguments(ARG "" "OUTPUT;SDK_DIR" "INTERFACES" ${ARGN})
+
+  file(GLOB_RECURSE sdk_headers "${ARG_SDK_DIR}/*.h")
+  set(sdk_content "")
+  foreach(header ${sdk_headers})
+    file(READ "${header}" header_content)
+    string(REPLACE "\r" "" header_content "${header_content}")
+    string(APPEND sdk_content "${header_content}\n")
+  endforeach()
+
+  set(out "// Generated by GenerateStubs.cmake. Do not edit.\n")
+  string(APPEND out "#pragma once\n\n#include \"stdafx.h\"\n")
+
+  foreach(interface ${ARG_INTERFACES})
+    # Locate the interface body: from "class IMTxxx" up to the first "  };".
+    string(FIND "${sdk_content}" "\nclass ${interface}\n" begin)
+    if(begin EQUAL -1)
+      message(FATAL_ERROR "mt5api_generate_stubs: ${interface} not found")
+    endif()
+    string(SUBSTRING "${sdk_content}" ${begin} -1 body)
+    string(FIND "${body}" "\n  };" end)
+    string(SUBSTRING "${body}" 0 ${end} body)
+
+    # Pure virtual methods are declared on a single line each. The trailing
+    # ';' is left out of the match so that results stay a valid CMake list.
+    string(REGEX MATCHALL "virtual [^\n]*=0" methods "${body}")
+
+    string(REGEX REPLACE "^IMT" "StubMT" stub "${interface}")
+    string(APPEND out "\nclass ${stub} : public ${interface} {\npublic:\n")
+    foreach(method ${methods})
+      if(NOT method MATCHES "^virtual +([^(]*[ *&])([A-Za-z_][A-Za-z0-9_]*)\\((.*)\\)( *const)? *=0$")
+        message(FATAL_ERROR "mt5api_generate_stubs: cannot parse '${method}'")
+      endif()
+      string(STRIP "${CMAKE_MATCH_1}" result)
+      set(name "${CMAKE_MATCH_2}")
+      set(params "${CMAKE_MATCH_3}")
+      set(qualifier "${CMAKE_MATCH_4}")
+      if(result STREQUAL "void")
+        set(impl "{}")
+      elseif(result STREQUAL "MTAPIRES")
+        set(impl "{ return MT_RET_ERR_NOTIMPLEMENT; }")
+      else()
+        set(impl "{ return {}; }")
+      endif()
+      string(APPEND out "  ${result} ${name}(${params})${qualifier} override ${impl}\n")
+    endforeach()
+    string(APPEND out "};\n")
+  endforeach()
+
+  # Only touch the output when it changes, to avoid needless rebuilds.
+  if(EXISTS "${ARG_OUTPUT}")
+    file(READ "${ARG_OUTPUT}" previous)
+  endif()
+  if(NOT previous STREQUAL out)
+    file(WRITE "${ARG_OUTPUT}" "${out}")
+  endif()
+endfunction()
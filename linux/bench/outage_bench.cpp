@@ -0,0 +1,177 @@
+// outage_bench.cpp : cost of a fake rate pass during a full-feed outage.
+//
+// Feeds one main feed tick for every symbol, then stops the main feed so
+// that all symbols are due at once every |timeout| milliseconds. Fake ticks the
+// plugin adds come back through the tick hooks as dealer ticks, they are
+// grouped by pass and the duration of each pass (first to last fake tick)
+// is reported with its lateness after the deadline. With --info=1 the
+// plugin logs at INFO instead of WARNING, the log records written and
+// dropped are reported.
+//
+// Ex:
+//    outage_bench --symbols=5000 --passes=5 --timeout=1000
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "fake_server_api.h"
+#include "log.h"
+
+MTAPIENTRY MTAPIRES MTServerCreate(UINT apiversion, IMTServerPlugin **plugin);
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const wchar_t kMainFeed[] = L"Main";
+
+// Records arrival time of fake ticks. Only the plugin generator thread
+// adds ticks, so arrivals are written by one thread.
+class FakeTickRecorder : public IMTTickSink {
+public:
+  explicit FakeTickRecorder(size_t capacity) : times_(capacity), count_(0) {}
+
+  MTAPIRES HookTick(const int feeder, MTTick&) override {
+    if (feeder != MT_FEEDER_DEALER)
+      return MT_RET_OK;
+    size_t index = count_.load(std::memory_order_relaxed);
+    if (index < times_.size()) {
+      times_[index] = Clock::now();
+      count_.store(index + 1, std::memory_order_release);
+    }
+    return MT_RET_OK;
+  }
+
+  size_t Count() const { return count_.load(std::memory_order_acquire); }
+  const std::vector<Clock::time_point>& Times() const { return times_; }
+
+private:
+  std::vector<Clock::time_point> times_;
+  std::atomic<size_t> count_;
+};
+
+struct Pass {
+  size_t ticks;
+  Clock::time_point first;
+  Clock::time_point last;
+};
+
+long OptionValue(int argc, char* argv[], const char* name, long value) {
+  size_t length = std::strlen(name);
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], name, length) == 0 && argv[i][length] == '=')
+      value = std::atol(argv[i] + length + 1);
+  }
+  return value;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  int symbols = static_cast<int>(std::max(1L, OptionValue(argc, argv, "--symbols", 5000)));
+  int passes = static_cast<int>(std::max(1L, OptionValue(argc, argv, "--passes", 5)));
+  // Plugin timeout parameter (milliseconds).
+  long timeout = std::max(50L, OptionValue(argc, argv, "--timeout", 1000));
+  bool info = OptionValue(argc, argv, "--info", 0) != 0;
+
+  // Start from an empty snapshot, it is kept in "bases" next to the executable.
+  std::error_code error;
+  std::filesystem::remove(std::filesystem::read_symlink("/proc/self/exe").parent_path() /
+                          "bases" / "NonstopRate.snapshot", error);
+
+  FakeServerAPI server;
+  server.AddFeeder(kMainFeed);
+  std::vector<std::wstring> names;
+  for (int i = 0; i < symbols; i++) {
+    wchar_t name[32];
+    std::swprintf(name, 32, L"SYM%05d", i);
+    names.push_back(name);
+    server.AddSymbol(name, 5);
+  }
+  server.SetPluginParameter(TIMEOUT_PARAM_NAME, (std::to_wstring(timeout) + L"ms").c_str());
+  server.SetPluginParameter(FEEDER_PARAM_NAME, kMainFeed);
+  server.SetPluginParameter(LOG_LEVEL_PARAM_NAME, info ? L"INFO" : L"WARNING");
+  server.SetPluginParameter(L"03.Symbols", L"SYM*");
+
+  IMTServerPlugin* plugin = nullptr;
+  if (MTServerCreate(MTServerAPIVersion, &plugin) != MT_RET_OK ||
+      server.StartPlugin(plugin) != MT_RET_OK) {
+    std::fprintf(stderr, "Cannot start plugin\n");
+    return 1;
+  }
+  FakeTickRecorder recorder(static_cast<size_t>(symbols) * (passes + 2));
+  server.TickSubscribe(&recorder);
+
+  // Server clock follows the real time during the run.
+  std::atomic<bool> stop(false);
+  auto start = Clock::now();
+  INT64 start_time_msc = server.TimeCurrentMsc();
+  std::thread clock_thread([&]() {
+    while (!stop) {
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+      server.SetTimeMsc(start_time_msc + elapsed.count());
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+
+  // One main feed tick per symbol, then the outage begins.
+  for (auto& name : names) {
+    MTTick tick = {};
+    CMTStr::Copy(tick.symbol, _countof(tick.symbol), name.c_str());
+    tick.bid = 1.0;
+    tick.ask = 1.0002;
+    tick.datetime_msc = server.TimeCurrentMsc();
+    tick.datetime = tick.datetime_msc / 1000;
+    server.FeedTick(MT_FEEDER_OFFSET, tick);
+  }
+  auto outage = Clock::now();
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(timeout * passes + timeout / 2));
+  stop = true;
+  clock_thread.join();
+  server.StopPlugin(plugin);
+  server.TickUnsubscribe(&recorder);
+  plugin->Release();
+
+  // Group fake ticks by pass, ticks further apart than half the timeout
+  // belong to different passes.
+  auto pass_gap = std::chrono::milliseconds(timeout / 2);
+  std::vector<Pass> found;
+  const auto& times = recorder.Times();
+  for (size_t i = 0; i < recorder.Count(); i++) {
+    if (found.empty() || times[i] - found.back().last > pass_gap)
+      found.push_back(Pass{ 0, times[i], times[i] });
+    found.back().ticks++;
+    found.back().last = times[i];
+  }
+
+  using std::chrono::microseconds;
+  using std::chrono::duration_cast;
+  std::printf("symbols: %d, timeout: %ldms\n", symbols, timeout);
+  for (size_t i = 0; i < found.size(); i++) {
+    const Pass& pass = found[i];
+    auto deadline = outage + std::chrono::milliseconds(timeout * static_cast<long>(i + 1));
+    long long span = duration_cast<microseconds>(pass.last - pass.first).count();
+    std::printf("pass %zu: %zu ticks, %lld us (%.0f ns/tick), first tick %+lld us after deadline\n",
+                i + 1, pass.ticks, span,
+                pass.ticks ? 1000.0 * span / pass.ticks : 0.0,
+                static_cast<long long>(duration_cast<microseconds>(pass.first - deadline).count()));
+  }
+  LogEngine::Stats log = LogEngine::GetStats();
+  std::printf("log: %llu records written, %llu dropped, %llu blocked\n",
+              static_cast<unsigned long long>(log.written),
+              static_cast<unsigned long long>(log.dropped),
+              static_cast<unsigned long long>(log.blocked));
+  return 0;
+}
@@ -0,0 +1,221 @@
+// price_bench.cpp : cost of the fake prices of a generator pass.
+//
+// Moves the prices of |symbols| due symbols |rounds| times, with the
+// previous per-symbol code (one shared std::mt19937, redrawn until the
+// offset differs from the last one) and with |FakePriceBatch| for every
+// price model, whose inputs are gathered from the symbols as the AddRate
+// pass does. Also reports the offsets each model produces: repeats of the
+// previous offset, their range and mean size, and how often bid moved.
+// Fake prices are then fitted into the quote limits of the symbols (tick
+// size of 2 points, spread filter of 18..22 points), the share of prices
+// off the tick grid or outside the filter, and of prices repeating the
+// previous fake ones, is reported before and after. Offsets of fitted
+// prices are in ticks, as in the plugin.
+//
+// Ex:
+//    price_bench --symbols=10000 --rounds=200
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "fake_price.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Generator state of a symbol, as in |RateInfo|.
+struct Symbol {
+  double bid;
+  double ask;
+  double point;
+  // Last real prices.
+  double base_bid;
+  double base_ask;
+  int last_rand;
+  UINT64 rand_stream;
+  UINT64 rand_counter;
+};
+
+// Quote settings of the symbols: a 20 points spread, a 2 points tick size
+// and a spread filter around it.
+const UINT kDigits = 5;
+const double kPoint = 0.00001;
+const double kTickSize = 2 * kPoint;
+const UINT kFilterSpreadMin = 18;
+const UINT kFilterSpreadMax = 22;
+
+struct Check {
+  UINT64 repeats = 0;
+  UINT64 price_repeats = 0;
+  UINT64 off_grid = 0;
+  UINT64 off_band = 0;
+  UINT64 bid_moves = 0;
+  int min_offset = 0;
+  int max_offset = 0;
+  double offset_sum = 0;
+
+  void Add(int previous, int offset, double old_bid, double bid) {
+    repeats += offset == previous;
+    bid_moves += bid != old_bid;
+    min_offset = std::min(min_offset, offset);
+    max_offset = std::max(max_offset, offset);
+    offset_sum += std::abs(offset);
+  }
+
+  void AddQuote(double previous_bid, double previous_ask, double bid, double ask) {
+    price_repeats += bid == previous_bid && ask == previous_ask;
+    double ticks = bid / kTickSize;
+    off_grid += std::abs(ticks - std::round(ticks)) > 1e-6;
+    double spread = (ask - bid) / kPoint;
+    off_band += spread < kFilterSpreadMin - 1e-6 || spread > kFilterSpreadMax + 1e-6;
+  }
+};
+
+long OptionValue(int argc, char* argv[], const char* name, long value) {
+  size_t length = std::strlen(name);
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], name, length) == 0 && argv[i][length] == '=')
+      value = std::atol(argv[i] + length + 1);
+  }
+  return value;
+}
+
+std::vector<Symbol> MakeSymbols(int count) {
+  std::vector<Symbol> symbols(count);
+  std::mt19937_64 engine(42);
+  for (auto& symbol : symbols) {
+    symbol.bid = 1.0;
+    symbol.ask = 1.0002;
+    symbol.point = kPoint;
+    symbol.base_bid = symbol.bid;
+    symbol.base_ask = symbol.ask;
+    symbol.last_rand = 0;
+    symbol.rand_stream = engine();
+    symbol.rand_counter = 0;
+  }
+  return symbols;
+}
+
+// Previous implementation.
+double RunOld(std::vector<Symbol>& symbols, int rounds, Check& check) {
+  std::mt19937 number_engine(42);
+  auto start = Clock::now();
+  for (int round = 0; round < rounds; round++) {
+    for (auto& symbol : symbols) {
+      std::uniform_int_distribution<int> dist(0, 4);
+      int rand;
+      while ((rand = dist(number_engine) - 2) == symbol.last_rand);
+      double offset = rand * symbol.point;
+      double old_bid = symbol.bid;
+      symbol.bid += offset;
+      symbol.ask += offset;
+      check.Add(symbol.last_rand, rand, old_bid, symbol.bid);
+      symbol.last_rand = rand;
+    }
+  }
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// Prices move from the last real ones, kept as |base_bid|/|base_ask|, as
+// in the plugin.
+// Prices are fitted into |limits| if it is set.
+double RunBatch(PriceModel model, std::vector<Symbol>& symbols, int rounds,
+                const QuoteLimits* limits, Check& check, double& kernel_ns,
+                double& fit_ns) {
+  FakePriceBatch prices;
+  prices.Reserve(symbols.size());
+  kernel_ns = 0;
+  fit_ns = 0;
+  auto start = Clock::now();
+  for (int round = 0; round < rounds; round++) {
+    prices.Clear();
+    for (auto& symbol : symbols) {
+      prices.Add(symbol.base_bid, symbol.base_ask, limits ? limits->TickSize() : symbol.point,
+                 symbol.last_rand, symbol.rand_stream, symbol.rand_counter);
+    }
+    auto kernel_start = Clock::now();
+    prices.Generate(model);
+    kernel_ns += std::chrono::duration<double, std::nano>(Clock::now() - kernel_start).count();
+    if (limits) {
+      auto fit_start = Clock::now();
+      // A frozen bid is kept, as in the plugin.
+      for (size_t i = 0; i < symbols.size(); i++) {
+        if (model == PRICE_FROZEN_BID)
+          limits->FitAsk(prices.bid[i], prices.ask[i]);
+        else
+          limits->Fit(prices.bid[i], prices.ask[i]);
+      }
+      fit_ns += std::chrono::duration<double, std::nano>(Clock::now() - fit_start).count();
+    }
+    for (size_t i = 0; i < symbols.size(); i++) {
+      Symbol& symbol = symbols[i];
+      check.Add(symbol.last_rand, prices.last_offset[i], symbol.base_bid, prices.bid[i]);
+      check.AddQuote(symbol.bid, symbol.ask, prices.bid[i], prices.ask[i]);
+      symbol.bid = prices.bid[i];
+      symbol.ask = prices.ask[i];
+      symbol.last_rand = prices.last_offset[i];
+      symbol.rand_counter = prices.counter[i];
+    }
+  }
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+void Print(const char* name, double ns, int symbols, int rounds, const Check& check) {
+  UINT64 total = static_cast<UINT64>(symbols) * rounds;
+  std::printf("%-18s %7.2f ns/symbol %9.1f us/pass  repeats=%.3f offsets=%d..%d"
+              " mean|offset|=%.2f bid_moves=%.3f off_grid=%.3f off_band=%.3f"
+              " price_repeats=%.3f\n",
+              name, ns / total, ns / rounds / 1000,
+              static_cast<double>(check.repeats) / total, check.min_offset, check.max_offset,
+              check.offset_sum / total, static_cast<double>(check.bid_moves) / total,
+              static_cast<double>(check.off_grid) / total,
+              static_cast<double>(check.off_band) / total,
+              static_cast<double>(check.price_repeats) / total);
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  int symbols = static_cast<int>(std::max(1L, OptionValue(argc, argv, "--symbols", 10000)));
+  int rounds = static_cast<int>(std::max(1L, OptionValue(argc, argv, "--rounds", 200)));
+
+  std::vector<Symbol> old_symbols = MakeSymbols(symbols);
+  Check old_check;
+  double old_ns = RunOld(old_symbols, rounds, old_check);
+  std::printf("symbols per pass: %d, passes: %d\n", symbols, rounds);
+  Print("per-symbol", old_ns, symbols, rounds, old_check);
+
+  QuoteLimits limits(kDigits, kTickSize, 0, 0, kFilterSpreadMin, kFilterSpreadMax);
+  for (int model = 0; model < PRICE_MODEL_NUM; model++) {
+    std::wstring model_name = price_model::Name(static_cast<PriceModel>(model));
+    char name[64];
+    const QuoteLimits* fits[] = { nullptr, &limits };
+    for (const QuoteLimits* fit : fits) {
+      std::vector<Symbol> batch_symbols = MakeSymbols(symbols);
+      Check check;
+      double kernel_ns = 0, fit_ns = 0;
+      double batch_ns = RunBatch(static_cast<PriceModel>(model), batch_symbols, rounds,
+                                 fit, check, kernel_ns, fit_ns);
+      std::snprintf(name, sizeof(name), "%ls%s", model_name.c_str(), fit ? " fitted" : "");
+      Print(name, batch_ns, symbols, rounds, check);
+      if (fit) {
+        std::snprintf(name, sizeof(name), "%ls fit", model_name.c_str());
+        Print(name, fit_ns, symbols, rounds, check);
+      } else {
+        std::snprintf(name, sizeof(name), "%ls kernel", model_name.c_str());
+        Print(name, kernel_ns, symbols, rounds, check);
+      }
+    }
+  }
+  return 0;
+}
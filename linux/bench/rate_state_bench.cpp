@@ -0,0 +1,170 @@
+// rate_state_bench.cpp : contention of per-symbol rate state updates.
+//
+// Several hook threads update rates of their own symbols while one thread
+// takes snapshots of all symbols, as the AddRate thread does. Compares the
+// previous design (one mutex for all symbols) with per-symbol |SeqLock|s,
+// and checks that snapshots are never torn.
+//
+// Ex:
+//    rate_state_bench --threads=8 --symbols=2000 --duration=3
+//    rate_state_bench --threads=16 --shared      // All threads, all symbols.
+
+#include "stdafx.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "nonstop_rate_plugin.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using RateState = NonstopRatePlugin::RateState;
+
+struct Options {
+  int threads = 8;
+  int symbols = 2000;
+  double duration = 3;
+  // Hook threads update all symbols instead of their own subset.
+  bool shared = false;
+};
+
+struct Result {
+  UINT64 updates = 0;
+  UINT64 snapshots = 0;
+  UINT64 torn = 0;
+};
+
+// Rate written for update number |n|, every field is derived from |n| so a
+// snapshot mixing two updates is detected.
+RateState MakeState(UINT64 n) {
+  RateState state;
+  state.last_bid = static_cast<double>(n);
+  state.last_ask = static_cast<double>(n) + 1;
+  state.last_real_rate_msc = static_cast<INT64>(n);
+  state.last_rate_msc = static_cast<INT64>(n);
+  state.has_real_rate = true;
+  return state;
+}
+
+bool IsConsistent(const RateState& state) {
+  if (!state.has_real_rate)
+    return state.last_bid == 0 && state.last_ask == 0;
+  return state.last_ask == state.last_bid + 1 &&
+         state.last_real_rate_msc == static_cast<INT64>(state.last_bid) &&
+         state.last_rate_msc == state.last_real_rate_msc;
+}
+
+// Previous design: plain values behind one mutex.
+class MutexStates {
+public:
+  explicit MutexStates(int symbols) : states_(symbols) {}
+  void Store(int symbol, const RateState& state) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    states_[symbol] = state;
+  }
+  RateState Load(int symbol) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return states_[symbol];
+  }
+private:
+  std::vector<RateState> states_;
+  std::mutex mutex_;
+};
+
+class SeqLockStates {
+public:
+  explicit SeqLockStates(int symbols) : states_(symbols) {}
+  void Store(int symbol, const RateState& state) { states_[symbol].Store(state); }
+  RateState Load(int symbol) { return states_[symbol].Load(); }
+private:
+  std::vector<SeqLock<RateState>> states_;
+};
+
+template<typename StatesT>
+Result Run(const Options& options) {
+  StatesT states(options.symbols);
+  std::atomic<bool> stop(false);
+  std::vector<UINT64> updates(options.threads, 0);
+  Result result;
+
+  std::vector<std::thread> writers;
+  for (int t = 0; t < options.threads; t++) {
+    writers.emplace_back([&, t]() {
+      UINT64 n = 0;
+      int first = options.shared ? 0 : t;
+      int step = options.shared ? 1 : options.threads;
+      while (!stop.load(std::memory_order_relaxed)) {
+        for (int symbol = first; symbol < options.symbols; symbol += step)
+          states.Store(symbol, MakeState(++n));
+      }
+      updates[t] = n;
+    });
+  }
+
+  std::thread reader([&]() {
+    while (!stop.load(std::memory_order_relaxed)) {
+      for (int symbol = 0; symbol < options.symbols; symbol++) {
+        if (!IsConsistent(states.Load(symbol)))
+          result.torn++;
+        result.snapshots++;
+      }
+    }
+  });
+
+  std::this_thread::sleep_for(std::chrono::duration<double>(options.duration));
+  stop = true;
+  for (auto& writer : writers)
+    writer.join();
+  reader.join();
+
+  for (UINT64 n : updates)
+    result.updates += n;
+  return result;
+}
+
+void Print(const char* name, const Options& options, const Result& result) {
+  std::printf("%-8s %16.0f %16.0f %8llu\n", name,
+              result.updates / options.duration,
+              result.snapshots / options.duration,
+              static_cast<unsigned long long>(result.torn));
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--threads=", 10) == 0)
+      options.threads = std::atoi(argv[i] + 10);
+    else if (std::strncmp(argv[i], "--symbols=", 10) == 0)
+      options.symbols = std::atoi(argv[i] + 10);
+    else if (std::strncmp(argv[i], "--duration=", 11) == 0)
+      options.duration = std::atof(argv[i] + 11);
+    else if (std::strcmp(argv[i], "--shared") == 0)
+      options.shared = true;
+    else {
+      std::fprintf(stderr, "Usage: %s [--threads=N] [--symbols=N] [--duration=S] [--shared]\n",
+                   argv[0]);
+      return 1;
+    }
+  }
+  if (options.threads <= 0 || options.symbols < options.threads || options.duration <= 0) {
+    std::fprintf(stderr, "Invalid arguments\n");
+    return 1;
+  }
+
+  std::printf("hook threads: %d, symbols: %d, %s symbols, hardware threads: %u\n",
+              options.threads, options.symbols, options.shared ? "shared" : "own",
+              std::thread::hardware_concurrency());
+  std::printf("%-8s %16s %16s %8s\n", "state", "updates/s", "snapshots/s", "torn");
+  Print("mutex", options, Run<MutexStates>(options));
+  Print("seqlock", options, Run<SeqLockStates>(options));
+  return 0;
+}
@@ -0,0 +1,168 @@
+// reject_bench.cpp : fake rates results counted by the plugin.
+//
+// Starts the plugin with |symbols| symbols while the main feed is down
+// after one tick per symbol. Every |reject|-th symbol has a spread filter
+// no quote passes, so the fake server rejects all its fake ticks. After
+// |timeout| * |passes| milliseconds the stats snapshot of the plugin is
+// compared with the fake server counts, and the cost of the snapshot and
+// of counting one result are reported.
+//
+// Ex:
+//    reject_bench --symbols=10000
+//    reject_bench --symbols=10000 --reject=2
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "fake_server_api.h"
+#include "nonstop_rate_plugin.h"
+
+MTAPIENTRY MTAPIRES MTServerCreate(UINT apiversion, IMTServerPlugin **plugin);
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const wchar_t kMainFeed[] = L"Main";
+
+long OptionValue(int argc, char* argv[], const char* name, long value) {
+  size_t length = std::strlen(name);
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], name, length) == 0 && argv[i][length] == '=')
+      value = std::atol(argv[i] + length + 1);
+  }
+  return value;
+}
+
+// Cost of |TickAddCounters::Add| (nanoseconds), |share| of results
+// rejected with 2 codes.
+double CountCost(UINT64 count, int reject) {
+  TickAddCounters counters;
+  auto start = Clock::now();
+  for (UINT64 i = 0; i < count; i++) {
+    MTAPIRES res = reject != 0 && i % reject == 0 ? (i & 1 ? MT_RET_ERR_PARAMS : MT_RET_ERR_DATA)
+                                                  : MT_RET_OK;
+    counters.Add(res);
+  }
+  double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  if (counters.Accepted() + counters.Rejected() != count)
+    std::fprintf(stderr, "Counters lost results\n");
+  return ns / count;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  int symbols = static_cast<int>(std::max(1L, OptionValue(argc, argv, "--symbols", 10000)));
+  int passes = static_cast<int>(std::max(1L, OptionValue(argc, argv, "--passes", 3)));
+  // Plugin timeout parameter (milliseconds).
+  long timeout = std::max(50L, OptionValue(argc, argv, "--timeout", 500));
+  int reject = static_cast<int>(std::max(0L, OptionValue(argc, argv, "--reject", 10)));
+
+  // Start from an empty snapshot, it is kept in "bases" next to the executable.
+  std::error_code error;
+  std::filesystem::remove(std::filesystem::read_symlink("/proc/self/exe").parent_path() /
+                          "bases" / "NonstopRate.snapshot", error);
+
+  FakeServerAPI server;
+  server.AddFeeder(kMainFeed);
+  std::vector<std::wstring> names;
+  int rejecting = 0;
+  for (int i = 0; i < symbols; i++) {
+    wchar_t name[32];
+    std::swprintf(name, 32, L"SYM%05d", i);
+    names.push_back(name);
+    FakeConSymbol config(name, 5);
+    if (reject != 0 && i % reject == 0) {
+      // Fitted quotes have at most 10 points spread, the filter wants 20.
+      config.FilterSpreadMin(20);
+      config.FilterSpreadMax(10);
+      rejecting++;
+    }
+    server.SymbolAdd(&config);
+  }
+  server.SetPluginParameter(TIMEOUT_PARAM_NAME, (std::to_wstring(timeout) + L"ms").c_str());
+  server.SetPluginParameter(FEEDER_PARAM_NAME, kMainFeed);
+  server.SetPluginParameter(LOG_LEVEL_PARAM_NAME, L"ERROR");
+  server.SetPluginParameter(L"03.Symbols", L"SYM*");
+
+  // Server clock follows the real time during the run.
+  std::atomic<bool> stop(false);
+  auto start = Clock::now();
+  INT64 start_time_msc = server.TimeCurrentMsc();
+  std::thread clock_thread([&]() {
+    while (!stop) {
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+      server.SetTimeMsc(start_time_msc + elapsed.count());
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+
+  IMTServerPlugin* plugin = nullptr;
+  if (MTServerCreate(MTServerAPIVersion, &plugin) != MT_RET_OK ||
+      server.StartPlugin(plugin) != MT_RET_OK) {
+    std::fprintf(stderr, "Cannot start plugin\n");
+    return 1;
+  }
+  for (auto& name : names) {
+    MTTick tick = {};
+    CMTStr::Copy(tick.symbol, _countof(tick.symbol), name.c_str());
+    tick.bid = 1.0;
+    tick.ask = 1.0002;
+    tick.datetime_msc = server.TimeCurrentMsc();
+    tick.datetime = tick.datetime_msc / 1000;
+    server.FeedTick(MT_FEEDER_OFFSET, tick);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(timeout * passes + timeout / 2));
+
+  // Snapshot while the plugin runs.
+  std::vector<NonstopRatePlugin::SymbolTickStats> stats;
+  auto stats_start = Clock::now();
+  static_cast<NonstopRatePlugin*>(plugin)->TickStats(stats);
+  double stats_us = std::chrono::duration<double, std::micro>(Clock::now() - stats_start).count();
+
+  stop = true;
+  clock_thread.join();
+  server.StopPlugin(plugin);
+  plugin->Release();
+
+  UINT64 accepted = 0, rejected = 0;
+  size_t rejected_symbols = 0;
+  std::vector<TickAddCounters::Count> codes;
+  for (auto& entry : stats) {
+    accepted += entry.accepted;
+    rejected += entry.rejected;
+    rejected_symbols += entry.rejected != 0;
+    TickAddCounters::Merge(codes, entry.rejections);
+  }
+
+  std::printf("symbols: %d (%d with a failing spread filter), timeout: %ldms, passes: %d\n",
+              symbols, rejecting, timeout, passes);
+  std::printf("server:  added %llu, rejected %llu\n",
+              static_cast<unsigned long long>(server.TicksAdded() - server.TicksRejected()),
+              static_cast<unsigned long long>(server.TicksRejected()));
+  std::printf("plugin:  accepted %llu, rejected %llu of %zu symbols",
+              static_cast<unsigned long long>(accepted), static_cast<unsigned long long>(rejected),
+              rejected_symbols);
+  for (auto& code : codes) {
+    if (code.other)
+      std::printf(", other codes=%llu", static_cast<unsigned long long>(code.count));
+    else
+      std::printf(", %ls (%u)=%llu", SMTFormat::FormatError(code.code), code.code,
+                  static_cast<unsigned long long>(code.count));
+  }
+  std::printf("\nstats snapshot of %zu symbols: %.1f us\n", stats.size(), stats_us);
+  std::printf("counting one result: %.2f ns\n", CountCost(100000000, reject));
+  return 0;
+}
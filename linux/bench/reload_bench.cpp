@@ -0,0 +1,116 @@
+// reload_bench.cpp : cost of reloading plugin parameters.
+//
+// Configures |symbols| symbols on the fake server and in the plugin
+// parameters, either listed by name over "NN.Symbols" parameters or as one
+// mask, then times parameter reloads (OnPluginUpdate up to the new
+// configuration being published). The timeout alternates so every reload
+// changes the configuration.
+//
+// Ex:
+//    reload_bench --symbols=10000 --reloads=20
+//    reload_bench --symbols=10000 --mask=1
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "fake_server_api.h"
+
+MTAPIENTRY MTAPIRES MTServerCreate(UINT apiversion, IMTServerPlugin **plugin);
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const wchar_t kMainFeed[] = L"Main";
+
+// Maximum number of "NN.Symbols" plugin parameters.
+const size_t kMaxSymbolParams = 99;
+
+long OptionValue(int argc, char* argv[], const char* name, long value) {
+  size_t length = std::strlen(name);
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], name, length) == 0 && argv[i][length] == '=')
+      value = std::atol(argv[i] + length + 1);
+  }
+  return value;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  size_t symbols = static_cast<size_t>(std::max(1L, OptionValue(argc, argv, "--symbols", 10000)));
+  int reloads = static_cast<int>(std::max(1L, OptionValue(argc, argv, "--reloads", 20)));
+  bool mask = OptionValue(argc, argv, "--mask", 0) != 0;
+
+  // Start from an empty snapshot, it is kept in "bases" next to the executable.
+  std::error_code error;
+  std::filesystem::remove(std::filesystem::read_symlink("/proc/self/exe").parent_path() /
+                          "bases" / "NonstopRate.snapshot", error);
+
+  FakeServerAPI server;
+  server.AddFeeder(kMainFeed);
+  std::vector<std::wstring> names;
+  for (size_t i = 0; i < symbols; i++) {
+    wchar_t name[32];
+    std::swprintf(name, 32, L"SYM%05zu", i);
+    names.push_back(name);
+    server.AddSymbol(name, 5);
+  }
+  server.SetPluginParameter(TIMEOUT_PARAM_NAME, L"30");
+  server.SetPluginParameter(FEEDER_PARAM_NAME, kMainFeed);
+  server.SetPluginParameter(LOG_LEVEL_PARAM_NAME, L"WARNING");
+
+  size_t params = 1;
+  if (mask) {
+    server.SetPluginParameter(L"01.Symbols", L"SYM*");
+  } else {
+    // Spread symbols over "NN.Symbols" parameters.
+    params = std::min(kMaxSymbolParams, symbols);
+    size_t per_param = (symbols + params - 1) / params;
+    for (size_t param = 0; param * per_param < symbols; param++) {
+      std::wstring value;
+      for (size_t i = param * per_param; i < std::min(symbols, (param + 1) * per_param); i++)
+        value += names[i] + L", ";
+      wchar_t name[16];
+      std::swprintf(name, 16, L"%02zu.Symbols", param + 1);
+      server.SetPluginParameter(name, value.c_str());
+    }
+  }
+
+  IMTServerPlugin* plugin = nullptr;
+  if (MTServerCreate(MTServerAPIVersion, &plugin) != MT_RET_OK ||
+      server.StartPlugin(plugin) != MT_RET_OK) {
+    std::fprintf(stderr, "Cannot start plugin\n");
+    return 1;
+  }
+
+  std::vector<double> times_ms;
+  for (int i = 0; i < reloads; i++) {
+    server.SetPluginParameter(TIMEOUT_PARAM_NAME, i % 2 ? L"30" : L"31");
+    auto begin = Clock::now();
+    server.NotifyPluginUpdate();
+    times_ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - begin).count());
+  }
+  server.StopPlugin(plugin);
+  plugin->Release();
+
+  std::sort(times_ms.begin(), times_ms.end());
+  double total = 0;
+  for (double time : times_ms)
+    total += time;
+  std::printf("symbols: %zu in %zu %s, reloads: %d\n", symbols, params,
+              mask ? "mask" : "parameters", reloads);
+  std::printf("reload: mean %.3f ms, median %.3f ms, min %.3f ms, max %.3f ms\n",
+              total / times_ms.size(), times_ms[times_ms.size() / 2],
+              times_ms.front(), times_ms.back());
+  return 0;
+}
@@ -0,0 +1,153 @@
+// restart_bench.cpp : fake rate coverage right after a plugin restart.
+//
+// Feeds one main feed tick per symbol to a first plugin instance, stops
+// it, then starts a second one while the main feed is down. Its fake
+// ticks during |timeout| * |passes| milliseconds are counted: with the
+// rates snapshot every symbol is covered from the first pass, without it
+// (--snapshot=0 removes the file before the restart) none is.
+// Also reports the time of each plugin start.
+//
+// Ex:
+//    restart_bench --symbols=10000
+//    restart_bench --symbols=10000 --snapshot=0
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "fake_server_api.h"
+
+MTAPIENTRY MTAPIRES MTServerCreate(UINT apiversion, IMTServerPlugin **plugin);
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const wchar_t kMainFeed[] = L"Main";
+
+class FakeTickCounter : public IMTTickSink {
+public:
+  FakeTickCounter() : count_(0) {}
+
+  MTAPIRES HookTick(const int feeder, MTTick&) override {
+    if (feeder == MT_FEEDER_DEALER)
+      count_++;
+    return MT_RET_OK;
+  }
+
+  size_t Count() const { return count_; }
+
+private:
+  std::atomic<size_t> count_;
+};
+
+long OptionValue(int argc, char* argv[], const char* name, long value) {
+  size_t length = std::strlen(name);
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], name, length) == 0 && argv[i][length] == '=')
+      value = std::atol(argv[i] + length + 1);
+  }
+  return value;
+}
+
+// Start a new plugin instance on |server|, return it and its start time.
+IMTServerPlugin* StartPlugin(FakeServerAPI& server, double& start_ms) {
+  IMTServerPlugin* plugin = nullptr;
+  auto start = Clock::now();
+  if (MTServerCreate(MTServerAPIVersion, &plugin) != MT_RET_OK ||
+      server.StartPlugin(plugin) != MT_RET_OK) {
+    std::fprintf(stderr, "Cannot start plugin\n");
+    std::exit(1);
+  }
+  start_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  return plugin;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  int symbols = static_cast<int>(std::max(1L, OptionValue(argc, argv, "--symbols", 5000)));
+  int passes = static_cast<int>(std::max(1L, OptionValue(argc, argv, "--passes", 3)));
+  // Plugin timeout parameter (milliseconds).
+  long timeout = std::max(50L, OptionValue(argc, argv, "--timeout", 500));
+  bool snapshot = OptionValue(argc, argv, "--snapshot", 1) != 0;
+
+  // The plugin keeps its snapshot in "bases" next to the executable.
+  std::filesystem::path snapshot_path =
+      std::filesystem::read_symlink("/proc/self/exe").parent_path() / "bases" / "NonstopRate.snapshot";
+  std::error_code error;
+  std::filesystem::remove(snapshot_path, error);
+
+  FakeServerAPI server;
+  server.AddFeeder(kMainFeed);
+  std::vector<std::wstring> names;
+  for (int i = 0; i < symbols; i++) {
+    wchar_t name[32];
+    std::swprintf(name, 32, L"SYM%05d", i);
+    names.push_back(name);
+    server.AddSymbol(name, 5);
+  }
+  server.SetPluginParameter(TIMEOUT_PARAM_NAME, (std::to_wstring(timeout) + L"ms").c_str());
+  server.SetPluginParameter(FEEDER_PARAM_NAME, kMainFeed);
+  server.SetPluginParameter(LOG_LEVEL_PARAM_NAME, L"WARNING");
+  server.SetPluginParameter(L"03.Symbols", L"SYM*");
+
+  // Server clock follows the real time during the run.
+  std::atomic<bool> stop(false);
+  auto start = Clock::now();
+  INT64 start_time_msc = server.TimeCurrentMsc();
+  std::thread clock_thread([&]() {
+    while (!stop) {
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+      server.SetTimeMsc(start_time_msc + elapsed.count());
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+
+  // First run: one main feed tick per symbol.
+  double cold_start_ms = 0;
+  IMTServerPlugin* plugin = StartPlugin(server, cold_start_ms);
+  for (auto& name : names) {
+    MTTick tick = {};
+    CMTStr::Copy(tick.symbol, _countof(tick.symbol), name.c_str());
+    tick.bid = 1.0;
+    tick.ask = 1.0002;
+    tick.datetime_msc = server.TimeCurrentMsc();
+    tick.datetime = tick.datetime_msc / 1000;
+    server.FeedTick(MT_FEEDER_OFFSET, tick);
+  }
+  server.StopPlugin(plugin);
+  plugin->Release();
+  if (!snapshot)
+    std::filesystem::remove(snapshot_path, error);
+
+  // Second run: the main feed is down from the start.
+  double warm_start_ms = 0;
+  plugin = StartPlugin(server, warm_start_ms);
+  FakeTickCounter counter;
+  server.TickSubscribe(&counter);
+  std::this_thread::sleep_for(std::chrono::milliseconds(timeout * passes + timeout / 2));
+  stop = true;
+  clock_thread.join();
+  server.StopPlugin(plugin);
+  server.TickUnsubscribe(&counter);
+  plugin->Release();
+
+  std::printf("symbols: %d, timeout: %ldms, passes: %d, snapshot: %s\n",
+              symbols, timeout, passes, snapshot ? "on" : "off");
+  std::printf("start: %.1f ms empty snapshot, %.1f ms after restart\n",
+              cold_start_ms, warm_start_ms);
+  std::printf("fake ticks after restart: %zu (%.1f per symbol)\n",
+              counter.Count(), static_cast<double>(counter.Count()) / symbols);
+  return 0;
+}
@@ -0,0 +1,146 @@
+// seed_bench.cpp : plugin start time when rates are seeded from last ticks.
+//
+// Configures |symbols| symbols whose last server tick is one second old,
+// each |TickLast| call taking |latency| microseconds, and starts the
+// plugin with an empty snapshot while the main feed is down. Reports the
+// start time and the fake ticks added during |timeout| * |passes|
+// milliseconds; seeded symbols are covered from the first pass. The start
+// time is compared with the same |TickLast| calls made one by one.
+// --seed=0 disables seeding (SnapshotMaxAge=0) for comparison.
+//
+// Ex:
+//    seed_bench --symbols=10000
+//    seed_bench --symbols=10000 --latency=50
+//    seed_bench --symbols=10000 --seed=0
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "fake_server_api.h"
+
+MTAPIENTRY MTAPIRES MTServerCreate(UINT apiversion, IMTServerPlugin **plugin);
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const wchar_t kMainFeed[] = L"Main";
+
+class FakeTickCounter : public IMTTickSink {
+public:
+  FakeTickCounter() : count_(0) {}
+
+  MTAPIRES HookTick(const int feeder, MTTick&) override {
+    if (feeder == MT_FEEDER_DEALER)
+      count_++;
+    return MT_RET_OK;
+  }
+
+  size_t Count() const { return count_; }
+
+private:
+  std::atomic<size_t> count_;
+};
+
+long OptionValue(int argc, char* argv[], const char* name, long value) {
+  size_t length = std::strlen(name);
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], name, length) == 0 && argv[i][length] == '=')
+      value = std::atol(argv[i] + length + 1);
+  }
+  return value;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  int symbols = static_cast<int>(std::max(1L, OptionValue(argc, argv, "--symbols", 10000)));
+  int passes = static_cast<int>(std::max(1L, OptionValue(argc, argv, "--passes", 3)));
+  // Plugin timeout parameter (milliseconds).
+  long timeout = std::max(50L, OptionValue(argc, argv, "--timeout", 500));
+  UINT latency = static_cast<UINT>(std::max(0L, OptionValue(argc, argv, "--latency", 20)));
+  bool seed = OptionValue(argc, argv, "--seed", 1) != 0;
+
+  // Start from an empty snapshot, it is kept in "bases" next to the executable.
+  std::error_code error;
+  std::filesystem::remove(std::filesystem::read_symlink("/proc/self/exe").parent_path() /
+                          "bases" / "NonstopRate.snapshot", error);
+
+  FakeServerAPI server;
+  server.AddFeeder(kMainFeed);
+  std::vector<std::wstring> names;
+  for (int i = 0; i < symbols; i++) {
+    wchar_t name[32];
+    std::swprintf(name, 32, L"SYM%05d", i);
+    names.push_back(name);
+    server.AddSymbol(name, 5);
+    MTTickShort tick = {};
+    tick.bid = 1.0;
+    tick.ask = 1.0002;
+    tick.datetime_msc = server.TimeCurrentMsc() - 1000;
+    tick.datetime = tick.datetime_msc / 1000;
+    server.SetTickLast(name, tick);
+  }
+  server.SetTickLastLatency(latency);
+  server.SetPluginParameter(TIMEOUT_PARAM_NAME, (std::to_wstring(timeout) + L"ms").c_str());
+  server.SetPluginParameter(FEEDER_PARAM_NAME, kMainFeed);
+  server.SetPluginParameter(LOG_LEVEL_PARAM_NAME, L"WARNING");
+  server.SetPluginParameter(SNAPSHOT_MAX_AGE_PARAM_NAME, seed ? L"300" : L"0");
+  server.SetPluginParameter(L"03.Symbols", L"SYM*");
+
+  // Server clock follows the real time during the run.
+  std::atomic<bool> stop(false);
+  auto start = Clock::now();
+  INT64 start_time_msc = server.TimeCurrentMsc();
+  std::thread clock_thread([&]() {
+    while (!stop) {
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+      server.SetTimeMsc(start_time_msc + elapsed.count());
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+
+  IMTServerPlugin* plugin = nullptr;
+  auto plugin_start = Clock::now();
+  if (MTServerCreate(MTServerAPIVersion, &plugin) != MT_RET_OK ||
+      server.StartPlugin(plugin) != MT_RET_OK) {
+    std::fprintf(stderr, "Cannot start plugin\n");
+    return 1;
+  }
+  double start_ms = std::chrono::duration<double, std::milli>(Clock::now() - plugin_start).count();
+  FakeTickCounter counter;
+  server.TickSubscribe(&counter);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(timeout * passes + timeout / 2));
+  stop = true;
+  clock_thread.join();
+  server.StopPlugin(plugin);
+  server.TickUnsubscribe(&counter);
+  plugin->Release();
+
+  auto serial_start = Clock::now();
+  for (auto& name : names) {
+    MTTickShort tick;
+    server.TickLast(name.c_str(), tick);
+  }
+  double serial_ms = std::chrono::duration<double, std::milli>(Clock::now() - serial_start).count();
+
+  std::printf("symbols: %d, TickLast latency: %uus, seeding: %s\n",
+              symbols, latency, seed ? "on" : "off");
+  std::printf("start: %.1f ms, TickLast of all symbols one by one: %.1f ms\n",
+              start_ms, serial_ms);
+  std::printf("fake ticks: %zu (%.1f per symbol) in %d passes of %ldms\n",
+              counter.Count(), static_cast<double>(counter.Count()) / symbols, passes, timeout);
+  return 0;
+}
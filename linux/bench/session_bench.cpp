@@ -0,0 +1,195 @@
+// session_bench.cpp : fake rates of symbols whose quote sessions are closed.
+//
+// Configures |symbols| symbols quoted Monday to Friday, sets the server
+// clock to |wday| (0: Sunday) at |minute| of the current week and stops
+// the main feed after one tick per symbol, as on a Friday evening. The
+// server clock then follows the real time. Reports the fake ticks added
+// and the CPU time spent while |timeout| elapses |passes| times; closed
+// symbols must get no fake tick and cost nothing until their session
+// opens. With --holiday=1 the simulated day is a holiday of all symbols.
+// Also times the quote schedule lookups of the AddRate thread.
+//
+// Ex:
+//    session_bench --symbols=5000 --wday=6
+//    session_bench --symbols=5000 --wday=3 --holiday=1
+//    session_bench --wday=5 --minute=1439 --timeout=10000 --passes=12
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "fake_server_api.h"
+#include "quote_schedule.h"
+
+MTAPIENTRY MTAPIRES MTServerCreate(UINT apiversion, IMTServerPlugin **plugin);
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const wchar_t kMainFeed[] = L"Main";
+
+class FakeTickCounter : public IMTTickSink {
+public:
+  FakeTickCounter() : count_(0) {}
+
+  MTAPIRES HookTick(const int feeder, MTTick&) override {
+    if (feeder == MT_FEEDER_DEALER)
+      count_++;
+    return MT_RET_OK;
+  }
+
+  size_t Count() const { return count_; }
+
+private:
+  std::atomic<size_t> count_;
+};
+
+long OptionValue(int argc, char* argv[], const char* name, long value) {
+  size_t length = std::strlen(name);
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], name, length) == 0 && argv[i][length] == '=')
+      value = std::atol(argv[i] + length + 1);
+  }
+  return value;
+}
+
+// Average nanoseconds of |schedule|.NextOpen over a week of minutes.
+double MeasureNextOpen(const QuoteSchedule& schedule, INT64 week_begin, INT64& checksum) {
+  const int kRounds = 20;
+  auto start = Clock::now();
+  for (int round = 0; round < kRounds; round++) {
+    for (UINT minute = 0; minute < QuoteSchedule::kMinutesInWeek; minute++)
+      checksum += schedule.NextOpen(week_begin + minute * 60LL + round);
+  }
+  double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  return elapsed / kRounds / QuoteSchedule::kMinutesInWeek;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  int symbols = static_cast<int>(std::max(1L, OptionValue(argc, argv, "--symbols", 5000)));
+  int passes = static_cast<int>(std::max(1L, OptionValue(argc, argv, "--passes", 5)));
+  // Plugin timeout parameter (milliseconds).
+  long timeout = std::max(50L, OptionValue(argc, argv, "--timeout", 1000));
+  UINT wday = static_cast<UINT>(OptionValue(argc, argv, "--wday", 6)) % 7;
+  UINT minute = static_cast<UINT>(OptionValue(argc, argv, "--minute", 12 * 60)) % 1440;
+  bool holiday = OptionValue(argc, argv, "--holiday", 0) != 0;
+
+  // Start from an empty snapshot, it is kept in "bases" next to the executable.
+  std::error_code error;
+  std::filesystem::remove(std::filesystem::read_symlink("/proc/self/exe").parent_path() /
+                          "bases" / "NonstopRate.snapshot", error);
+
+  FakeServerAPI server;
+  INT64 week_begin = SMTTime::WeekBegin(server.TimeCurrent());
+  INT64 start_time = week_begin + wday * 86400LL + minute * 60LL;
+  server.SetTimeMsc(start_time * 1000);
+
+  server.AddFeeder(kMainFeed);
+  std::vector<std::wstring> names;
+  for (int i = 0; i < symbols; i++) {
+    wchar_t name[32];
+    std::swprintf(name, 32, L"SYM%05d", i);
+    names.push_back(name);
+    FakeConSymbol symbol(name, 5);
+    symbol.Path((std::wstring(L"Bench\\") + name).c_str());
+    for (UINT day = 0; day < 7; day++) {
+      symbol.SessionQuoteClear(day);
+      FakeConSymbolSession session(0, 24 * 60);
+      if (day >= 1 && day <= 5)
+        symbol.SessionQuoteAdd(day, &session);
+    }
+    server.SymbolAdd(&symbol);
+  }
+  if (holiday) {
+    tm date = {};
+    SMTTime::ParseTime(start_time, &date);
+    FakeConHoliday config;
+    config.Year(date.tm_year + 1900);
+    config.Month(date.tm_mon + 1);
+    config.Day(date.tm_mday);
+    config.SymbolAdd(L"Bench\\*");
+    server.HolidayAdd(&config);
+  }
+  server.SetPluginParameter(TIMEOUT_PARAM_NAME, (std::to_wstring(timeout) + L"ms").c_str());
+  server.SetPluginParameter(FEEDER_PARAM_NAME, kMainFeed);
+  server.SetPluginParameter(LOG_LEVEL_PARAM_NAME, L"WARNING");
+  server.SetPluginParameter(L"03.Symbols", L"SYM*");
+  server.SetDatafeedsTimeout(3600);
+
+  IMTServerPlugin* plugin = nullptr;
+  if (MTServerCreate(MTServerAPIVersion, &plugin) != MT_RET_OK ||
+      server.StartPlugin(plugin) != MT_RET_OK) {
+    std::fprintf(stderr, "Cannot start plugin\n");
+    return 1;
+  }
+  FakeTickCounter counter;
+  server.TickSubscribe(&counter);
+
+  // Server clock follows the real time during the run.
+  std::atomic<bool> stop(false);
+  auto start = Clock::now();
+  std::thread clock_thread([&]() {
+    while (!stop) {
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+      server.SetTimeMsc(start_time * 1000 + elapsed.count());
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+
+  // One main feed tick per symbol, then the outage begins.
+  for (auto& name : names) {
+    MTTick tick = {};
+    CMTStr::Copy(tick.symbol, _countof(tick.symbol), name.c_str());
+    tick.bid = 1.0;
+    tick.ask = 1.0002;
+    tick.datetime_msc = server.TimeCurrentMsc();
+    tick.datetime = tick.datetime_msc / 1000;
+    server.FeedTick(MT_FEEDER_OFFSET, tick);
+  }
+
+  std::clock_t cpu_start = std::clock();
+  std::this_thread::sleep_for(std::chrono::milliseconds(timeout * passes + timeout / 2));
+  double cpu_ms = 1000.0 * (std::clock() - cpu_start) / CLOCKS_PER_SEC;
+  stop = true;
+  clock_thread.join();
+  server.StopPlugin(plugin);
+  server.TickUnsubscribe(&counter);
+  plugin->Release();
+
+  // Lookups of a weekdays schedule, and of one with a holiday.
+  QuoteSchedule weekdays;
+  for (UINT day = 1; day <= 5; day++)
+    weekdays.AddSession(day, 0, 24 * 60);
+  QuoteSchedule holidays = weekdays;
+  QuoteSchedule::Holiday closed;
+  closed.month = 12;
+  closed.day = 25;
+  holidays.AddHoliday(closed);
+  INT64 checksum = 0;
+  double weekdays_ns = MeasureNextOpen(weekdays, week_begin, checksum);
+  double holidays_ns = MeasureNextOpen(holidays, week_begin, checksum);
+
+  static const char* const kDays[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+  std::printf("symbols: %d, timeout: %ldms, passes: %d, server time: %s %02u:%02u%s\n",
+              symbols, timeout, passes, kDays[wday], minute / 60, minute % 60,
+              holiday ? " (holiday)" : "");
+  std::printf("fake ticks: %zu (%.1f per symbol), cpu: %.1f ms\n",
+              counter.Count(), static_cast<double>(counter.Count()) / symbols, cpu_ms);
+  std::printf("NextOpen: %.1f ns weekdays, %.1f ns with a holiday (checksum %lld)\n",
+              weekdays_ns, holidays_ns, static_cast<long long>(checksum));
+  return 0;
+}
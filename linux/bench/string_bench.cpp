@@ -0,0 +1,165 @@
+// string_bench.cpp : cost of common::Split and common::Trim.
+//
+// Splits and trims a symbols list as in "NN.Symbols" parameters, with the
+// std::wstring functions common.cpp had before and with the string view
+// templates, eagerly (Split) and lazily (SplitView), for wchar_t and char.
+// Also checks that all of them produce the same items.
+//
+// Ex:
+//    string_bench --symbols=10000 --rounds=200
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Previous implementation: copies every item, then copies it again trimmed.
+std::vector<std::wstring> OldSplit(const std::wstring& s, wchar_t delim) {
+  std::vector<std::wstring> ret;
+  std::size_t curr = s.find(delim);
+  std::size_t prev = 0;
+
+  while (curr != std::wstring::npos) {
+    ret.push_back(s.substr(prev, curr - prev));
+    prev = curr + 1;
+    curr = s.find(delim, prev);
+  }
+  ret.push_back(s.substr(prev, curr - prev));
+
+  return ret;
+}
+
+std::wstring OldTrim(const std::wstring &s) {
+  auto const is_space = [](int c) {
+    return std::isspace(c);
+  };
+
+  auto wsfront = std::find_if_not(s.begin(), s.end(), is_space);
+  auto wsback = std::find_if_not(s.rbegin(), s.rend(), is_space).base();
+  return (wsback <= wsfront ? std::wstring() : std::wstring(wsfront, wsback));
+}
+
+// Symbols list with the spacing administrators type.
+template<typename CharT>
+std::basic_string<CharT> MakeList(int symbols) {
+  std::basic_string<CharT> list;
+  for (int i = 0; i < symbols; i++) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%sSYM%05d.%s", i % 4 ? "" : " ", i, i % 3 ? "pro" : "m");
+    list.append(name, name + std::strlen(name));
+    if (i + 1 < symbols) {
+      list.push_back(CharT(','));
+      if (i % 2)
+        list.push_back(CharT(' '));
+    }
+  }
+  return list;
+}
+
+// Run |split| over |rounds| rounds, return nanoseconds per item. |split|
+// returns the total length of the trimmed items so that nothing is
+// optimized away.
+template<typename SplitT>
+double Measure(int rounds, size_t items, size_t& length, SplitT split) {
+  length = 0;
+  auto start = Clock::now();
+  for (int round = 0; round < rounds; round++)
+    length += split();
+  double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  length /= rounds;
+  return elapsed / rounds / items;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  int symbols = 10000;
+  int rounds = 200;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--symbols=", 10) == 0)
+      symbols = std::max(1, std::atoi(argv[i] + 10));
+    else if (std::strncmp(argv[i], "--rounds=", 9) == 0)
+      rounds = std::max(1, std::atoi(argv[i] + 9));
+    else {
+      std::fprintf(stderr, "Usage: %s [--symbols=N] [--rounds=N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  std::wstring wide = MakeList<wchar_t>(symbols);
+  std::string narrow = MakeList<char>(symbols);
+
+  // Same items from every implementation.
+  std::vector<std::wstring> expected;
+  for (auto& item : OldSplit(wide, L','))
+    expected.push_back(OldTrim(item));
+  std::vector<std::wstring_view> split = common::Split(wide, L',');
+  bool same = split.size() == expected.size();
+  for (size_t i = 0; same && i < split.size(); i++)
+    same = common::Trim(split[i]) == expected[i];
+  size_t index = 0;
+  for (std::wstring_view item : common::SplitView(wide, L','))
+    same = same && index < expected.size() && common::Trim(item) == expected[index++];
+  same = same && index == expected.size();
+  index = 0;
+  for (std::string_view item : common::SplitView(narrow, ',')) {
+    std::string_view trimmed = common::Trim(item);
+    same = same && index < expected.size() &&
+           std::equal(trimmed.begin(), trimmed.end(),
+                      expected[index].begin(), expected[index].end());
+    index++;
+  }
+  if (!same) {
+    std::fprintf(stderr, "Implementations disagree\n");
+    return 1;
+  }
+
+  size_t items = expected.size();
+  size_t old_length, split_length, lazy_length, narrow_length;
+  double old_ns = Measure(rounds, items, old_length, [&]() {
+    size_t length = 0;
+    for (auto& item : OldSplit(wide, L','))
+      length += OldTrim(item).size();
+    return length;
+  });
+  double split_ns = Measure(rounds, items, split_length, [&]() {
+    size_t length = 0;
+    for (auto item : common::Split(wide, L','))
+      length += common::Trim(item).size();
+    return length;
+  });
+  double lazy_ns = Measure(rounds, items, lazy_length, [&]() {
+    size_t length = 0;
+    for (auto item : common::SplitView(wide, L','))
+      length += common::Trim(item).size();
+    return length;
+  });
+  double narrow_ns = Measure(rounds, items, narrow_length, [&]() {
+    size_t length = 0;
+    for (auto item : common::SplitView(narrow, ','))
+      length += common::Trim(item).size();
+    return length;
+  });
+
+  std::printf("items: %zu, rounds: %d\n", items, rounds);
+  std::printf("wstring Split + Trim:       %7.1f ns/item\n", old_ns);
+  std::printf("wstring_view Split + Trim:  %7.1f ns/item\n", split_ns);
+  std::printf("wstring_view SplitView:     %7.1f ns/item\n", lazy_ns);
+  std::printf("string_view SplitView:      %7.1f ns/item\n", narrow_ns);
+  if (old_length != split_length || old_length != lazy_length || old_length != narrow_length)
+    std::printf("lengths differ: %zu %zu %zu %zu\n",
+                old_length, split_length, lazy_length, narrow_length);
+  return 0;
+}
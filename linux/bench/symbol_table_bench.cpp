@@ -0,0 +1,111 @@
+// symbol_table_bench.cpp : lookup cost of the plugin symbol table.
+//
+// Compares |SymbolTable| with the std::map<std::wstring, RateInfo> it
+// replaced, looking up names from MTTick-like fixed buffers as HookTick
+// does, for configured (hit) and unconfigured (miss) symbols.
+//
+// Ex:
+//    symbol_table_bench --symbols=5000 --lookups=10000000
+
+#include "stdafx.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "nonstop_rate_plugin.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using RateInfo = NonstopRatePlugin::RateInfo;
+
+struct SymbolBuffer {
+  wchar_t symbol[32];
+};
+
+// Symbol names of different lengths, as configured on real servers.
+std::vector<SymbolBuffer> MakeSymbols(int count, const wchar_t* prefix) {
+  std::vector<SymbolBuffer> symbols(count);
+  for (int i = 0; i < count; i++)
+    swprintf(symbols[i].symbol, 32, L"%ls%d.%ls", prefix, i, i % 3 ? L"pro" : L"m");
+  return symbols;
+}
+
+// Lookup order of ticks, |hit_percent| of them are configured symbols.
+std::vector<const wchar_t*> MakeStream(const std::vector<SymbolBuffer>& hits,
+                                       const std::vector<SymbolBuffer>& misses,
+                                       size_t length, int hit_percent) {
+  std::mt19937 engine(42);
+  std::uniform_int_distribution<int> percent(0, 99);
+  std::vector<const wchar_t*> stream(length);
+  for (auto& symbol : stream) {
+    const auto& source = percent(engine) < hit_percent ? hits : misses;
+    symbol = source[engine() % source.size()].symbol;
+  }
+  return stream;
+}
+
+template<typename FindT>
+double Measure(const std::vector<const wchar_t*>& stream, size_t lookups, FindT find) {
+  size_t found = 0;
+  auto start = Clock::now();
+  for (size_t i = 0; i < lookups; i++)
+    found += find(stream[i % stream.size()]) ? 1 : 0;
+  double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  // Keep lookups from being optimized away.
+  if (found == static_cast<size_t>(-1))
+    std::printf("unreachable\n");
+  return elapsed / lookups;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  int symbol_count = 2000;
+  size_t lookups = 10000000;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--symbols=", 10) == 0)
+      symbol_count = std::atoi(argv[i] + 10);
+    else if (std::strncmp(argv[i], "--lookups=", 10) == 0)
+      lookups = std::strtoull(argv[i] + 10, nullptr, 10);
+    else {
+      std::fprintf(stderr, "Usage: %s [--symbols=N] [--lookups=N]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (symbol_count <= 0 || lookups == 0) {
+    std::fprintf(stderr, "Invalid arguments\n");
+    return 1;
+  }
+
+  std::vector<SymbolBuffer> configured = MakeSymbols(symbol_count, L"SYM");
+  std::vector<SymbolBuffer> others = MakeSymbols(symbol_count, L"OTH");
+
+  std::map<std::wstring, RateInfo> map;
+  SymbolTable<RateInfo> table;
+  for (const auto& symbol : configured) {
+    map[symbol.symbol] = RateInfo();
+    table.Insert(symbol.symbol) = RateInfo();
+  }
+
+  std::printf("symbols: %d, lookups: %zu\n", symbol_count, lookups);
+  std::printf("%-10s %14s %14s\n", "hit rate", "map ns/op", "table ns/op");
+  for (int hit_percent : { 100, 50, 0 }) {
+    auto stream = MakeStream(configured, others, 1 << 16, hit_percent);
+    double map_ns = Measure(stream, lookups, [&](const wchar_t* symbol) {
+      auto it = map.find(symbol);
+      return it == map.end() ? nullptr : &it->second;
+    });
+    double table_ns = Measure(stream, lookups, [&](const wchar_t* symbol) {
+      return table.Find(symbol);
+    });
+    std::printf("%8d%% %14.1f %14.1f\n", hit_percent, map_ns, table_ns);
+  }
+  return 0;
+}
@@ -0,0 +1,120 @@
+// timestamp_bench.cpp : cost of formatting log record timestamps.
+//
+// Compares |TimestampCache| with the formatting LogEngine used before:
+// std::localtime and std::put_time into a std::wstringstream, once for the
+// record time and once for the log file date of every record.
+// Also checks that both produce the same date and time.
+//
+// Ex:
+//    timestamp_bench --records=2000000 --threads=4
+
+#include "stdafx.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "timestamp_cache.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using std::chrono::system_clock;
+
+// Previous LogEngine formatting, see GetCurrentDateTime/GetCurrentDate.
+std::wstring PutTime(system_clock::time_point time, const wchar_t* format) {
+  std::time_t now = system_clock::to_time_t(time);
+  struct std::tm* ptm = std::localtime(&now);
+  std::wstringstream sstream;
+  sstream << std::put_time(ptm, format);
+  return sstream.str();
+}
+
+// Run |format| |records| times on each of |threads| threads, return
+// nanoseconds per record.
+template<typename FormatT>
+double Measure(int threads, size_t records, FormatT format) {
+  std::vector<std::thread> workers;
+  std::vector<size_t> sizes(threads, 0);
+  auto start = Clock::now();
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t]() {
+      for (size_t i = 0; i < records; i++)
+        sizes[t] += format(system_clock::now());
+    });
+  }
+  for (auto& worker : workers)
+    worker.join();
+  double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  // Keep formatting from being optimized away.
+  size_t total = 0;
+  for (size_t size : sizes)
+    total += size;
+  if (total == 0)
+    std::printf("unreachable\n");
+  return elapsed / (static_cast<double>(records) * threads);
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  size_t records = 1000000;
+  int threads = 4;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--records=", 10) == 0)
+      records = std::strtoull(argv[i] + 10, nullptr, 10);
+    else if (std::strncmp(argv[i], "--threads=", 10) == 0)
+      threads = std::atoi(argv[i] + 10);
+    else {
+      std::fprintf(stderr, "Usage: %s [--records=N] [--threads=N]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (records == 0 || threads <= 0) {
+    std::fprintf(stderr, "Invalid arguments\n");
+    return 1;
+  }
+
+  // Same second, same text (retry if the second changed in between).
+  for (int attempt = 0; attempt < 3; attempt++) {
+    auto now = system_clock::now();
+    wchar_t text[TimestampCache<wchar_t>::kLength];
+    std::wstring cached(text, TimestampCache<wchar_t>::Format(now, text));
+    std::wstring expected = PutTime(now, L"%F %T");
+    if (cached.compare(0, expected.size(), expected) == 0) {
+      std::printf("sample:           %ls\n", cached.c_str());
+      break;
+    }
+    if (attempt == 2) {
+      std::printf("mismatch: %ls vs %ls\n", cached.c_str(), expected.c_str());
+      return 1;
+    }
+  }
+
+  std::printf("records: %zu per thread\n", records);
+  std::printf("%-28s %10s %10s\n", "formatter", "1 thread", "threads");
+  auto datetime = [](system_clock::time_point now) {
+    return PutTime(now, L"%F %T").size();
+  };
+  auto journal = [](system_clock::time_point now) {
+    return PutTime(now, L"%F %T").size() + PutTime(now, L"%Y%m%d").size();
+  };
+  auto cached = [](system_clock::time_point now) {
+    wchar_t text[TimestampCache<wchar_t>::kLength];
+    return TimestampCache<wchar_t>::Format(now, text);
+  };
+  std::printf("%-28s %10.1f %10.1f\n", "put_time date+time ns/rec",
+              Measure(1, records, datetime), Measure(threads, records, datetime));
+  std::printf("%-28s %10.1f %10.1f\n", "put_time per Journal ns/rec",
+              Measure(1, records, journal), Measure(threads, records, journal));
+  std::printf("%-28s %10.1f %10.1f\n", "TimestampCache ns/rec",
+              Measure(1, records, cached), Measure(threads, records, cached));
+  return 0;
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "mt5api_stubs.h"
+
+// In-memory configuration objects handed out by |FakeServerAPI|.
+// They keep only the fields read by the plugin; everything else falls back
+// to the generated stub implementation. |Assign| accepts only objects of
+// the same fake type, which is always the case inside the fake host.
+// Classes are final, as |Release| deletes them through their own type.
+
+class FakeConParam final : public StubMTConParam {
+public:
+  FakeConParam() = default;
+  FakeConParam(LPCWSTR name, LPCWSTR value) : name_(name), value_(value) {}
+
+  void Release(void) override { delete this; }
+  MTAPIRES Assign(const IMTConParam* param) override {
+    *this = *static_cast<const FakeConParam*>(param);
+    return MT_RET_OK;
+  }
+  MTAPIRES Clear(void) override { *this = FakeConParam(); return MT_RET_OK; }
+
+  LPCWSTR Name(void) const override { return name_.c_str(); }
+  MTAPIRES Name(LPCWSTR name) override { name_ = name; return MT_RET_OK; }
+  LPCWSTR Value(void) const override { return value_.c_str(); }
+  MTAPIRES Value(LPCWSTR value) override { value_ = value; return MT_RET_OK; }
+  LPCWSTR ValueString(void) const override { return value_.c_str(); }
+  MTAPIRES ValueString(LPCWSTR value) override { value_ = value; return MT_RET_OK; }
+  INT64 ValueInt(void) const override { return std::wcstoll(value_.c_str(), nullptr, 10); }
+
+private:
+  std::wstring name_;
+  std::wstring value_;
+};
+
+class FakeConPlugin final : public StubMTConPlugin {
+public:
+  void Release(void) override { delete this; }
+  MTAPIRES Assign(const IMTConPlugin* plugin) override {
+    *this = *static_cast<const FakeConPlugin*>(plugin);
+    return MT_RET_OK;
+  }
+  MTAPIRES Clear(void) override { *this = FakeConPlugin(); return MT_RET_OK; }
+
+  LPCWSTR Name(void) const override { return name_.c_str(); }
+  MTAPIRES Name(LPCWSTR name) override { name_ = name; return MT_RET_OK; }
+  UINT64 Server(void) const override { return server_; }
+  MTAPIRES Server(const UINT64 server) override { server_ = server; return MT_RET_OK; }
+
+  MTAPIRES ParameterAdd(IMTConParam* param) override {
+    params_.push_back(*static_cast<FakeConParam*>(param));
+    return MT_RET_OK;
+  }
+  MTAPIRES ParameterClear(void) override { params_.clear(); return MT_RET_OK; }
+  UINT ParameterTotal(void) const override { return static_cast<UINT>(params_.size()); }
+  MTAPIRES ParameterNext(const UINT pos, IMTConParam* param) const override {
+    if (pos >= params_.size() || !param) return MT_RET_ERR_PARAMS;
+    return param->Assign(&params_[pos]);
+  }
+
+  // Set parameter |name| to |value|, adding it when it does not exist.
+  void SetParameter(LPCWSTR name, LPCWSTR value) {
+    for (auto& param : params_) {
+      if (std::wcscmp(param.Name(), name) == 0) {
+        param.Value(value);
+        return;
+      }
+    }
+    params_.emplace_back(name, value);
+  }
+
+private:
+  std::wstring name_;
+  UINT64 server_ = 0;
+  std::vector<FakeConParam> params_;
+};
+
+class FakeConFeeder final : public StubMTConFeeder {
+public:
+  FakeConFeeder() = default;
+  explicit FakeConFeeder(LPCWSTR name) : name_(name) {}
+
+  void Release(void) override { delete this; }
+  MTAPIRES Assign(const IMTConFeeder* feeder) override {
+    *this = *static_cast<const FakeConFeeder*>(feeder);
+    return MT_RET_OK;
+  }
+  MTAPIRES Clear(void) override { *this = FakeConFeeder(); return MT_RET_OK; }
+
+  LPCWSTR Name(void) const override { return name_.c_str(); }
+  MTAPIRES Name(LPCWSTR name) override { name_ = name; return MT_RET_OK; }
+
+private:
+  std::wstring name_;
+};
+
+class FakeConSymbolSession final : public StubMTConSymbolSession {
+public:
+  FakeConSymbolSession() = default;
+  FakeConSymbolSession(UINT open, UINT close) : open_(open), close_(close) {}
+
+  void Release(void) override { delete this; }
+  MTAPIRES Assign(const IMTConSymbolSession* session) override {
+    *this = *static_cast<const FakeConSymbolSession*>(session);
+    return MT_RET_OK;
+  }
+  MTAPIRES Clear(void) override { *this = FakeConSymbolSession(); return MT_RET_OK; }
+
+  UINT Open(void) const override { return open_; }
+  MTAPIRES Open(const UINT open) override { open_ = open; return MT_RET_OK; }
+  UINT Close(void) const override { return close_; }
+  MTAPIRES Close(const UINT close) override { close_ = close; return MT_RET_OK; }
+
+private:
+  UINT open_ = 0;
+  UINT close_ = 0;
+};
+
+// Quote sessions are 00:00-24:00 every day until they are changed, as for
+// a new symbol on a real server.
+class FakeConSymbol final : public StubMTConSymbol {
+public:
+  FakeConSymbol() { ResetSessions(); }
+  FakeConSymbol(LPCWSTR symbol, UINT digits) : symbol_(symbol), digits_(digits) {
+    ResetSessions();
+  }
+
+  void Release(void) override { delete this; }
+  MTAPIRES Assign(const IMTConSymbol* symbol) override {
+    *this = *static_cast<const FakeConSymbol*>(symbol);
+    return MT_RET_OK;
+  }
+  MTAPIRES Clear(void) override { *this = FakeConSymbol(); return MT_RET_OK; }
+
+  LPCWSTR Symbol(void) const override { return symbol_.c_str(); }
+  MTAPIRES Symbol(LPCWSTR symbol) override { symbol_ = symbol; return MT_RET_OK; }
+  UINT Digits(void) const override { return digits_; }
+  MTAPIRES Digits(const UINT digits) override { digits_ = digits; return MT_RET_OK; }
+  double Point(void) const override { return SMTMath::DecPow(-static_cast<int>(digits_)); }
+  // Zero tick size means one point.
+  double TickSize(void) const override { return tick_size_ > 0 ? tick_size_ : Point(); }
+  MTAPIRES TickSize(const double size) override { tick_size_ = size; return MT_RET_OK; }
+  UINT QuotesTimeout(void) const override { return quotes_timeout_; }
+  MTAPIRES QuotesTimeout(const UINT timeout) override { quotes_timeout_ = timeout; return MT_RET_OK; }
+  // Fixed spread (points), 0 for a floating spread.
+  UINT Spread(void) const override { return spread_; }
+  MTAPIRES Spread(const UINT spread) override { spread_ = spread; return MT_RET_OK; }
+  INT SpreadBalance(void) const override { return spread_balance_; }
+  MTAPIRES SpreadBalance(const INT spread) override { spread_balance_ = spread; return MT_RET_OK; }
+  // Spread filter (points), 0 disables the bound.
+  UINT FilterSpreadMax(void) const override { return filter_spread_max_; }
+  MTAPIRES FilterSpreadMax(const UINT spread) override { filter_spread_max_ = spread; return MT_RET_OK; }
+  UINT FilterSpreadMin(void) const override { return filter_spread_min_; }
+  MTAPIRES FilterSpreadMin(const UINT spread) override { filter_spread_min_ = spread; return MT_RET_OK; }
+  // Empty path means the symbol is at the root of the symbols tree.
+  LPCWSTR Path(void) const override { return path_.empty() ? symbol_.c_str() : path_.c_str(); }
+  MTAPIRES Path(LPCWSTR path) override { path_ = path; return MT_RET_OK; }
+
+  MTAPIRES SessionQuoteAdd(const UINT wday, IMTConSymbolSession* session) override {
+    if (wday >= 7 || !session) return MT_RET_ERR_PARAMS;
+    quote_sessions_[wday].push_back(*static_cast<FakeConSymbolSession*>(session));
+    return MT_RET_OK;
+  }
+  MTAPIRES SessionQuoteClear(const UINT wday) override {
+    if (wday >= 7) return MT_RET_ERR_PARAMS;
+    quote_sessions_[wday].clear();
+    return MT_RET_OK;
+  }
+  UINT SessionQuoteTotal(const UINT wday) const override {
+    return wday < 7 ? static_cast<UINT>(quote_sessions_[wday].size()) : 0;
+  }
+  MTAPIRES SessionQuoteNext(const UINT wday, const UINT pos,
+                            IMTConSymbolSession* session) const override {
+    if (wday >= 7 || pos >= quote_sessions_[wday].size() || !session) return MT_RET_ERR_PARAMS;
+    return session->Assign(&quote_sessions_[wday][pos]);
+  }
+
+private:
+  void ResetSessions() {
+    for (auto& sessions : quote_sessions_)
+      sessions.assign(1, FakeConSymbolSession(0, 24 * 60));
+  }
+
+  std::wstring symbol_;
+  std::wstring path_;
+  UINT digits_ = 5;
+  double tick_size_ = 0;
+  UINT quotes_timeout_ = 0;
+  UINT spread_ = 0;
+  INT spread_balance_ = 0;
+  UINT filter_spread_max_ = 0;
+  UINT filter_spread_min_ = 0;
+  // Indexed by day of week, 0 is Sunday.
+  std::vector<FakeConSymbolSession> quote_sessions_[7];
+};
+
+class FakeConHoliday final : public StubMTConHoliday {
+public:
+  void Release(void) override { delete this; }
+  MTAPIRES Assign(const IMTConHoliday* holiday) override {
+    *this = *static_cast<const FakeConHoliday*>(holiday);
+    return MT_RET_OK;
+  }
+  MTAPIRES Clear(void) override { *this = FakeConHoliday(); return MT_RET_OK; }
+
+  LPCWSTR Description(void) const override { return description_.c_str(); }
+  MTAPIRES Description(LPCWSTR descr) override { description_ = descr; return MT_RET_OK; }
+  UINT Mode(void) const override { return mode_; }
+  MTAPIRES Mode(const UINT mode) override { mode_ = mode; return MT_RET_OK; }
+  UINT Year(void) const override { return year_; }
+  MTAPIRES Year(const UINT year) override { year_ = year; return MT_RET_OK; }
+  UINT Month(void) const override { return month_; }
+  MTAPIRES Month(const UINT month) override { month_ = month; return MT_RET_OK; }
+  UINT Day(void) const override { return day_; }
+  MTAPIRES Day(const UINT day) override { day_ = day; return MT_RET_OK; }
+  UINT WorkFrom(void) const override { return work_from_; }
+  MTAPIRES WorkFrom(const UINT from) override { work_from_ = from; return MT_RET_OK; }
+  UINT WorkTo(void) const override { return work_to_; }
+  MTAPIRES WorkTo(const UINT to) override { work_to_ = to; return MT_RET_OK; }
+
+  MTAPIRES SymbolAdd(LPCWSTR path) override {
+    if (!path) return MT_RET_ERR_PARAMS;
+    symbols_.push_back(path);
+    return MT_RET_OK;
+  }
+  MTAPIRES SymbolClear(void) override { symbols_.clear(); return MT_RET_OK; }
+  UINT SymbolTotal(void) const override { return static_cast<UINT>(symbols_.size()); }
+  LPCWSTR SymbolNext(const UINT pos) const override {
+    return pos < symbols_.size() ? symbols_[pos].c_str() : nullptr;
+  }
+
+private:
+  std::wstring description_;
+  UINT mode_ = HOLIDAY_ENABLED;
+  UINT year_ = 0;
+  UINT month_ = 1;
+  UINT day_ = 1;
+  UINT work_from_ = 0;
+  UINT work_to_ = 0;
+  std::vector<std::wstring> symbols_;
+};
+
+class FakeConServerHistory final : public StubMTConServerHistory {
+public:
+  void Release(void) override {}
+
+  UINT DatafeedsTimeout(void) const override { return datafeeds_timeout_; }
+  MTAPIRES DatafeedsTimeout(const UINT timeout) override {
+    datafeeds_timeout_ = timeout;
+    return MT_RET_OK;
+  }
+
+private:
+  UINT datafeeds_timeout_ = 60;
+};
+
+class FakeConServer final : public StubMTConServer {
+public:
+  FakeConServer() = default;
+  explicit FakeConServer(UINT type) : type_(type) {}
+
+  void Release(void) override { delete this; }
+  MTAPIRES Assign(IMTConServer* server) override {
+    *this = *static_cast<FakeConServer*>(server);
+    return MT_RET_OK;
+  }
+  MTAPIRES Clear(void) override { *this = FakeConServer(); return MT_RET_OK; }
+
+  UINT Type(void) const override { return type_; }
+  MTAPIRES Type(const UINT type) override { type_ = type; return MT_RET_OK; }
+  IMTConServerHistory* HistoryServer(void) override { return &history_; }
+
+private:
+  UINT type_ = NET_MAIN_TRADE_SERVER;
+  FakeConServerHistory history_;
+};
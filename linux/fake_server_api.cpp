@@ -0,0 +1,509 @@
+#include "stdafx.h"
+#include "fake_server_api.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace {
+
+// Name and identifier of the plugin instance hosted by the fake server.
+const wchar_t kPluginName[] = L"Nonstop Rate";
+const UINT64 kServerId = 1;
+
+}
+
+FakeServerAPI::FakeServerAPI()
+    : time_msc_(0),
+      tick_last_latency_us_(0),
+      has_spread_filters_(false),
+      ticks_added_(0),
+      ticks_rejected_(0) {
+  plugin_.Name(kPluginName);
+  plugin_.Server(kServerId);
+
+  // The plugin reads history server settings at position NET_HISTORY_SERVER.
+  servers_.emplace_back(IMTConServer::NET_MAIN_TRADE_SERVER);
+  servers_.emplace_back(IMTConServer::NET_TRADE_SERVER);
+  servers_.emplace_back(IMTConServer::NET_HISTORY_SERVER);
+
+  // Start from the current wall clock time.
+  using std::chrono::system_clock;
+  time_msc_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+      system_clock::now().time_since_epoch()).count();
+}
+
+FakeServerAPI::~FakeServerAPI() {
+}
+
+void FakeServerAPI::SetPluginParameter(LPCWSTR name, LPCWSTR value) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  plugin_.SetParameter(name, value);
+}
+
+void FakeServerAPI::AddFeeder(LPCWSTR name) {
+  FakeConFeeder feeder(name);
+  FeederAdd(&feeder);
+}
+
+MTAPIRES FakeServerAPI::RenameFeeder(const UINT pos, LPCWSTR name) {
+  std::vector<IMTConFeederSink*> sinks;
+  FakeConFeeder feeder;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    if (pos >= feeders_.size()) return MT_RET_ERR_NOTFOUND;
+    feeders_[pos].Name(name);
+    feeder = feeders_[pos];
+    sinks = feeder_sinks_;
+  }
+
+  for (auto sink : sinks)
+    sink->OnFeederUpdate(&feeder);
+  return MT_RET_OK;
+}
+
+void FakeServerAPI::AddSymbol(LPCWSTR symbol, UINT digits) {
+  FakeConSymbol config(symbol, digits);
+  SymbolAdd(&config);
+}
+
+MTAPIRES FakeServerAPI::RenameSymbol(LPCWSTR symbol, LPCWSTR name) {
+  if (!symbol || !name) return MT_RET_ERR_PARAMS;
+  std::vector<IMTConSymbolSink*> sinks;
+  FakeConSymbol config;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    auto it = std::find_if(symbols_.begin(), symbols_.end(), [symbol](const FakeConSymbol& entry) {
+      return CMTStr::Compare(entry.Symbol(), symbol) == 0;
+    });
+    if (it == symbols_.end()) return MT_RET_ERR_NOTFOUND;
+    it->Symbol(name);
+    config = *it;
+    auto filter = spread_filters_.find(symbol);
+    if (filter != spread_filters_.end()) {
+      spread_filters_[name] = filter->second;
+      spread_filters_.erase(symbol);
+    }
+    sinks = symbol_sinks_;
+  }
+
+  for (auto sink : sinks)
+    sink->OnSymbolUpdate(&config);
+  return MT_RET_OK;
+}
+
+void FakeServerAPI::SetDatafeedsTimeout(UINT timeout) {
+  std::vector<IMTConServerSink*> sinks;
+  FakeConServer history;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    for (auto& server : servers_)
+      if (server.Type() == IMTConServer::NET_HISTORY_SERVER)
+        server.HistoryServer()->DatafeedsTimeout(timeout);
+    history = servers_[IMTConServer::NET_HISTORY_SERVER];
+    sinks = server_sinks_;
+  }
+
+  for (auto sink : sinks)
+    sink->OnConServerUpdate(&history);
+}
+
+MTAPIRES FakeServerAPI::StartPlugin(IMTServerPlugin* plugin) {
+  if (!plugin) return MT_RET_ERR_PARAMS;
+  return plugin->Start(this);
+}
+
+MTAPIRES FakeServerAPI::StopPlugin(IMTServerPlugin* plugin) {
+  if (!plugin) return MT_RET_ERR_PARAMS;
+  return plugin->Stop();
+}
+
+void FakeServerAPI::NotifyPluginUpdate() {
+  std::vector<IMTConPluginSink*> sinks;
+  FakeConPlugin plugin;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    plugin = plugin_;
+    sinks = plugin_sinks_;
+  }
+
+  for (auto sink : sinks)
+    sink->OnPluginUpdate(&plugin);
+}
+
+MTAPIRES FakeServerAPI::FeedTick(const int feeder, MTTick& tick) {
+  MTAPIRES result = MT_RET_OK;
+  for (auto sink : tick_sinks_) {
+    if ((result = sink->HookTick(feeder, tick)) != MT_RET_OK)
+      return result;
+  }
+  return MT_RET_OK;
+}
+
+IMTConPlugin* FakeServerAPI::PluginCreate(void) {
+  return new(std::nothrow) FakeConPlugin();
+}
+
+IMTConParam* FakeServerAPI::PluginParamCreate(void) {
+  return new(std::nothrow) FakeConParam();
+}
+
+MTAPIRES FakeServerAPI::PluginSubscribe(IMTConPluginSink* sink) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return Subscribe(plugin_sinks_, sink);
+}
+
+MTAPIRES FakeServerAPI::PluginUnsubscribe(IMTConPluginSink* sink) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return Unsubscribe(plugin_sinks_, sink);
+}
+
+MTAPIRES FakeServerAPI::PluginCurrent(IMTConPlugin* plugin) {
+  if (!plugin) return MT_RET_ERR_PARAMS;
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return plugin->Assign(&plugin_);
+}
+
+IMTConServer* FakeServerAPI::NetServerCreate(void) {
+  return new(std::nothrow) FakeConServer();
+}
+
+MTAPIRES FakeServerAPI::NetServerSubscribe(IMTConServerSink* sink) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return Subscribe(server_sinks_, sink);
+}
+
+MTAPIRES FakeServerAPI::NetServerUnsubscribe(IMTConServerSink* sink) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return Unsubscribe(server_sinks_, sink);
+}
+
+UINT FakeServerAPI::NetServerTotal(void) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return static_cast<UINT>(servers_.size());
+}
+
+MTAPIRES FakeServerAPI::NetServerNext(const UINT pos, IMTConServer* config) {
+  if (!config) return MT_RET_ERR_PARAMS;
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  if (pos >= servers_.size()) return MT_RET_ERR_NOTFOUND;
+  return config->Assign(&servers_[pos]);
+}
+
+INT64 FakeServerAPI::TimeCurrent(void) {
+  return time_msc_ / 1000;
+}
+
+IMTConSymbol* FakeServerAPI::SymbolCreate(void) {
+  return new(std::nothrow) FakeConSymbol();
+}
+
+UINT FakeServerAPI::SymbolTotal(void) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return static_cast<UINT>(symbols_.size());
+}
+
+MTAPIRES FakeServerAPI::SymbolNext(const UINT pos, IMTConSymbol* symbol) {
+  if (!symbol) return MT_RET_ERR_PARAMS;
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  if (pos >= symbols_.size()) return MT_RET_ERR_NOTFOUND;
+  return symbol->Assign(&symbols_[pos]);
+}
+
+MTAPIRES FakeServerAPI::SymbolGet(LPCWSTR name, IMTConSymbol* symbol) {
+  if (!name || !symbol) return MT_RET_ERR_PARAMS;
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  for (auto& it : symbols_)
+    if (CMTStr::Compare(it.Symbol(), name) == 0)
+      return symbol->Assign(&it);
+  return MT_RET_ERR_NOTFOUND;
+}
+
+MTAPIRES FakeServerAPI::SymbolSubscribe(IMTConSymbolSink* sink) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return Subscribe(symbol_sinks_, sink);
+}
+
+MTAPIRES FakeServerAPI::SymbolUnsubscribe(IMTConSymbolSink* sink) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return Unsubscribe(symbol_sinks_, sink);
+}
+
+MTAPIRES FakeServerAPI::SymbolAdd(IMTConSymbol* symbol) {
+  if (!symbol) return MT_RET_ERR_PARAMS;
+  std::vector<IMTConSymbolSink*> sinks;
+  const FakeConSymbol& config = *static_cast<FakeConSymbol*>(symbol);
+  bool updated = false;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    for (auto& it : symbols_) {
+      if (CMTStr::Compare(it.Symbol(), config.Symbol()) == 0) {
+        it = config;
+        updated = true;
+        break;
+      }
+    }
+    if (!updated)
+      symbols_.push_back(config);
+    if (config.FilterSpreadMin() != 0 || config.FilterSpreadMax() != 0) {
+      spread_filters_[config.Symbol()] =
+          SpreadFilter{ config.Point(), config.FilterSpreadMin(), config.FilterSpreadMax() };
+      has_spread_filters_ = true;
+    } else {
+      spread_filters_.erase(config.Symbol());
+    }
+    sinks = symbol_sinks_;
+  }
+
+  for (auto sink : sinks) {
+    if (updated)
+      sink->OnSymbolUpdate(symbol);
+    else
+      sink->OnSymbolAdd(symbol);
+  }
+  return MT_RET_OK;
+}
+
+MTAPIRES FakeServerAPI::SymbolDelete(LPCWSTR name) {
+  if (!name) return MT_RET_ERR_PARAMS;
+  UINT pos = 0;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    for (; pos < symbols_.size(); pos++)
+      if (CMTStr::Compare(symbols_[pos].Symbol(), name) == 0)
+        break;
+  }
+  return SymbolDelete(pos);
+}
+
+MTAPIRES FakeServerAPI::SymbolDelete(const UINT pos) {
+  std::vector<IMTConSymbolSink*> sinks;
+  FakeConSymbol symbol;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    if (pos >= symbols_.size()) return MT_RET_ERR_NOTFOUND;
+    symbol = symbols_[pos];
+    symbols_.erase(symbols_.begin() + pos);
+    spread_filters_.erase(symbol.Symbol());
+    sinks = symbol_sinks_;
+  }
+
+  for (auto sink : sinks)
+    sink->OnSymbolDelete(&symbol);
+  return MT_RET_OK;
+}
+
+IMTConSymbolSession* FakeServerAPI::SymbolSessionCreate(void) {
+  return new(std::nothrow) FakeConSymbolSession();
+}
+
+IMTConHoliday* FakeServerAPI::HolidayCreate(void) {
+  return new(std::nothrow) FakeConHoliday();
+}
+
+MTAPIRES FakeServerAPI::HolidaySubscribe(IMTConHolidaySink* sink) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return Subscribe(holiday_sinks_, sink);
+}
+
+MTAPIRES FakeServerAPI::HolidayUnsubscribe(IMTConHolidaySink* sink) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return Unsubscribe(holiday_sinks_, sink);
+}
+
+MTAPIRES FakeServerAPI::HolidayAdd(IMTConHoliday* holiday) {
+  if (!holiday) return MT_RET_ERR_PARAMS;
+  std::vector<IMTConHolidaySink*> sinks;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    holidays_.push_back(*static_cast<FakeConHoliday*>(holiday));
+    sinks = holiday_sinks_;
+  }
+
+  for (auto sink : sinks)
+    sink->OnHolidayAdd(holiday);
+  return MT_RET_OK;
+}
+
+MTAPIRES FakeServerAPI::HolidayDelete(const UINT pos) {
+  std::vector<IMTConHolidaySink*> sinks;
+  FakeConHoliday holiday;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    if (pos >= holidays_.size()) return MT_RET_ERR_NOTFOUND;
+    holiday = holidays_[pos];
+    holidays_.erase(holidays_.begin() + pos);
+    sinks = holiday_sinks_;
+  }
+
+  for (auto sink : sinks)
+    sink->OnHolidayDelete(&holiday);
+  return MT_RET_OK;
+}
+
+UINT FakeServerAPI::HolidayTotal(void) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return static_cast<UINT>(holidays_.size());
+}
+
+MTAPIRES FakeServerAPI::HolidayNext(const UINT pos, IMTConHoliday* holiday) {
+  if (!holiday) return MT_RET_ERR_PARAMS;
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  if (pos >= holidays_.size()) return MT_RET_ERR_NOTFOUND;
+  return holiday->Assign(&holidays_[pos]);
+}
+
+IMTConFeeder* FakeServerAPI::FeederCreate(void) {
+  return new(std::nothrow) FakeConFeeder();
+}
+
+MTAPIRES FakeServerAPI::FeederSubscribe(IMTConFeederSink* sink) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return Subscribe(feeder_sinks_, sink);
+}
+
+MTAPIRES FakeServerAPI::FeederUnsubscribe(IMTConFeederSink* sink) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return Unsubscribe(feeder_sinks_, sink);
+}
+
+MTAPIRES FakeServerAPI::FeederAdd(IMTConFeeder* feeder) {
+  if (!feeder) return MT_RET_ERR_PARAMS;
+  std::vector<IMTConFeederSink*> sinks;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    feeders_.push_back(*static_cast<FakeConFeeder*>(feeder));
+    sinks = feeder_sinks_;
+  }
+
+  for (auto sink : sinks)
+    sink->OnFeederAdd(feeder);
+  return MT_RET_OK;
+}
+
+MTAPIRES FakeServerAPI::FeederDelete(LPCWSTR name) {
+  if (!name) return MT_RET_ERR_PARAMS;
+  UINT pos = 0;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    for (; pos < feeders_.size(); pos++)
+      if (CMTStr::Compare(feeders_[pos].Name(), name) == 0)
+        break;
+  }
+  return FeederDelete(pos);
+}
+
+MTAPIRES FakeServerAPI::FeederDelete(const UINT pos) {
+  std::vector<IMTConFeederSink*> sinks;
+  FakeConFeeder feeder;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    if (pos >= feeders_.size()) return MT_RET_ERR_NOTFOUND;
+    feeder = feeders_[pos];
+    feeders_.erase(feeders_.begin() + pos);
+    sinks = feeder_sinks_;
+  }
+
+  for (auto sink : sinks)
+    sink->OnFeederDelete(&feeder);
+  return MT_RET_OK;
+}
+
+MTAPIRES FakeServerAPI::FeederShift(const UINT pos, const int shift) {
+  std::vector<IMTConFeederSink*> sinks;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    INT64 new_pos = static_cast<INT64>(pos) + shift;
+    if (pos >= feeders_.size() || new_pos < 0 || new_pos >= static_cast<INT64>(feeders_.size()))
+      return MT_RET_ERR_PARAMS;
+    FakeConFeeder feeder = feeders_[pos];
+    feeders_.erase(feeders_.begin() + pos);
+    feeders_.insert(feeders_.begin() + new_pos, feeder);
+    sinks = feeder_sinks_;
+  }
+
+  // Reordering is reported as a synchronization of the whole list.
+  for (auto sink : sinks)
+    sink->OnFeederSync();
+  return MT_RET_OK;
+}
+
+UINT FakeServerAPI::FeederTotal(void) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return static_cast<UINT>(feeders_.size());
+}
+
+MTAPIRES FakeServerAPI::FeederNext(const UINT pos, IMTConFeeder* feeder) {
+  if (!feeder) return MT_RET_ERR_PARAMS;
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  if (pos >= feeders_.size()) return MT_RET_ERR_NOTFOUND;
+  return feeder->Assign(&feeders_[pos]);
+}
+
+MTAPIRES FakeServerAPI::TickSubscribe(IMTTickSink* sink) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return Subscribe(tick_sinks_, sink);
+}
+
+MTAPIRES FakeServerAPI::TickUnsubscribe(IMTTickSink* sink) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return Unsubscribe(tick_sinks_, sink);
+}
+
+MTAPIRES FakeServerAPI::TickAdd(MTTick& tick) {
+  ticks_added_++;
+  if (has_spread_filters_) {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    auto it = spread_filters_.find(tick.symbol);
+    if (it != spread_filters_.end()) {
+      const SpreadFilter& filter = it->second;
+      INT64 spread = std::llround((tick.ask - tick.bid) / filter.point);
+      if ((filter.min != 0 && spread < static_cast<INT64>(filter.min)) ||
+          (filter.max != 0 && spread > static_cast<INT64>(filter.max))) {
+        ticks_rejected_++;
+        return MT_RET_ERR_PARAMS;
+      }
+    }
+  }
+  // Ticks added through the API come back through the hooks as dealer ticks.
+  return FeedTick(MT_FEEDER_DEALER, tick);
+}
+
+void FakeServerAPI::SetTickLast(LPCWSTR symbol, const MTTickShort& tick) {
+  std::lock_guard<std::mutex> lock(tick_last_mutex_);
+  last_ticks_[symbol] = tick;
+}
+
+MTAPIRES FakeServerAPI::TickLast(LPCWSTR symbol, MTTickShort& tick) {
+  if (!symbol) return MT_RET_ERR_PARAMS;
+  if (UINT latency = tick_last_latency_us_)
+    std::this_thread::sleep_for(std::chrono::microseconds(latency));
+  std::lock_guard<std::mutex> lock(tick_last_mutex_);
+  auto it = last_ticks_.find(symbol);
+  if (it == last_ticks_.end()) return MT_RET_ERR_NOTFOUND;
+  tick = it->second;
+  return MT_RET_OK;
+}
+
+MTAPIRES FakeServerAPI::TickLast(const IMTConSymbol* symbol, MTTickShort& tick) {
+  if (!symbol) return MT_RET_ERR_PARAMS;
+  return TickLast(symbol->Symbol(), tick);
+}
+
+template<typename SinkT>
+MTAPIRES FakeServerAPI::Subscribe(std::vector<SinkT*>& sinks, SinkT* sink) {
+  if (!sink) return MT_RET_ERR_PARAMS;
+  if (std::find(sinks.begin(), sinks.end(), sink) != sinks.end())
+    return MT_RET_ERR_DUPLICATE;
+  sinks.push_back(sink);
+  return MT_RET_OK;
+}
+
+template<typename SinkT>
+MTAPIRES FakeServerAPI::Unsubscribe(std::vector<SinkT*>& sinks, SinkT* sink) {
+  auto it = std::find(sinks.begin(), sinks.end(), sink);
+  if (it == sinks.end()) return MT_RET_ERR_NOTFOUND;
+  sinks.erase(it);
+  return MT_RET_OK;
+}
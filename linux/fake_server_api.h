@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "fake_config.h"
+
+// In-process stand-in for the MT5 history server, used to run the plugin
+// on Linux. It implements the part of |IMTServerAPI| used by the plugin:
+// plugin, feeder, symbol, holiday and network server configuration, the tick stream
+// and a controllable clock. All other methods fall back to the generated
+// stub implementation and return MT_RET_ERR_NOTIMPLEMENT.
+// Configuration events are delivered synchronously on the calling thread.
+//
+// Ex:
+//    FakeServerAPI server;
+//    server.AddFeeder(L"MainFeed");
+//    server.AddSymbol(L"EURUSD", 5);
+//    server.SetPluginParameter(FEEDER_PARAM_NAME, L"MainFeed");
+//    server.SetPluginParameter(L"01.Symbols", L"EURUSD");
+//    server.StartPlugin(plugin);
+//    server.FeedTick(MT_FEEDER_OFFSET, tick);
+class FakeServerAPI : public StubMTServerAPI {
+public:
+  FakeServerAPI();
+  virtual ~FakeServerAPI();
+
+  // Host control: configuration.
+  void SetPluginParameter(LPCWSTR name, LPCWSTR value);
+  void AddFeeder(LPCWSTR name);
+  MTAPIRES RenameFeeder(const UINT pos, LPCWSTR name);
+  // Add symbol, or update it if it exists, and notify symbol sinks.
+  void AddSymbol(LPCWSTR symbol, UINT digits);
+  // Rename symbol, notified as an update with the new name as MT5 does.
+  MTAPIRES RenameSymbol(LPCWSTR symbol, LPCWSTR name);
+  void SetDatafeedsTimeout(UINT timeout);
+
+  // Host control: controllable clock (milliseconds since 01/01/1970).
+  // The clock does not move by itself.
+  void SetTimeMsc(INT64 time_msc) { time_msc_ = time_msc; }
+  void AdvanceTimeMsc(INT64 delta_msc) { time_msc_ += delta_msc; }
+  INT64 TimeCurrentMsc() const { return time_msc_; }
+
+  // Host control: plugin lifetime and events.
+  MTAPIRES StartPlugin(IMTServerPlugin* plugin);
+  MTAPIRES StopPlugin(IMTServerPlugin* plugin);
+  // Notify plugin sinks about the current plugin configuration.
+  void NotifyPluginUpdate();
+
+  // Pass |tick| through all tick hooks, as the server does for every
+  // incoming quote from |feeder|.
+  MTAPIRES FeedTick(const int feeder, MTTick& tick);
+
+  // Set the last tick of |symbol| returned by |TickLast|. Ticks passed
+  // through |FeedTick| are not recorded, so the hook benchmarks do not pay
+  // for it.
+  void SetTickLast(LPCWSTR symbol, const MTTickShort& tick);
+  // Time each |TickLast| call takes, as a lookup of the server history.
+  void SetTickLastLatency(UINT latency_us) { tick_last_latency_us_ = latency_us; }
+
+  // Number of ticks added through |TickAdd| since start, and of those
+  // rejected by the spread filter of their symbol.
+  UINT64 TicksAdded() const { return ticks_added_; }
+  UINT64 TicksRejected() const { return ticks_rejected_; }
+
+  // IMTServerAPI implementations.
+  // Plugin configuration.
+  IMTConPlugin* PluginCreate(void) override;
+  IMTConParam* PluginParamCreate(void) override;
+  MTAPIRES PluginSubscribe(IMTConPluginSink* sink) override;
+  MTAPIRES PluginUnsubscribe(IMTConPluginSink* sink) override;
+  MTAPIRES PluginCurrent(IMTConPlugin* plugin) override;
+  // Network server configuration.
+  IMTConServer* NetServerCreate(void) override;
+  MTAPIRES NetServerSubscribe(IMTConServerSink* sink) override;
+  MTAPIRES NetServerUnsubscribe(IMTConServerSink* sink) override;
+  UINT NetServerTotal(void) override;
+  MTAPIRES NetServerNext(const UINT pos, IMTConServer* config) override;
+  // Time.
+  INT64 TimeCurrent(void) override;
+  // Symbols configuration.
+  IMTConSymbol* SymbolCreate(void) override;
+  UINT SymbolTotal(void) override;
+  MTAPIRES SymbolNext(const UINT pos, IMTConSymbol* symbol) override;
+  MTAPIRES SymbolGet(LPCWSTR name, IMTConSymbol* symbol) override;
+  MTAPIRES SymbolSubscribe(IMTConSymbolSink* sink) override;
+  MTAPIRES SymbolUnsubscribe(IMTConSymbolSink* sink) override;
+  MTAPIRES SymbolAdd(IMTConSymbol* symbol) override;
+  MTAPIRES SymbolDelete(LPCWSTR name) override;
+  MTAPIRES SymbolDelete(const UINT pos) override;
+  IMTConSymbolSession* SymbolSessionCreate(void) override;
+  // Holidays configuration.
+  IMTConHoliday* HolidayCreate(void) override;
+  MTAPIRES HolidaySubscribe(IMTConHolidaySink* sink) override;
+  MTAPIRES HolidayUnsubscribe(IMTConHolidaySink* sink) override;
+  MTAPIRES HolidayAdd(IMTConHoliday* holiday) override;
+  MTAPIRES HolidayDelete(const UINT pos) override;
+  UINT HolidayTotal(void) override;
+  MTAPIRES HolidayNext(const UINT pos, IMTConHoliday* holiday) override;
+  // Datafeeds configuration.
+  IMTConFeeder* FeederCreate(void) override;
+  MTAPIRES FeederSubscribe(IMTConFeederSink* sink) override;
+  MTAPIRES FeederUnsubscribe(IMTConFeederSink* sink) override;
+  MTAPIRES FeederAdd(IMTConFeeder* feeder) override;
+  MTAPIRES FeederDelete(LPCWSTR name) override;
+  MTAPIRES FeederDelete(const UINT pos) override;
+  MTAPIRES FeederShift(const UINT pos, const int shift) override;
+  UINT FeederTotal(void) override;
+  MTAPIRES FeederNext(const UINT pos, IMTConFeeder* feeder) override;
+  // Ticks.
+  MTAPIRES TickSubscribe(IMTTickSink* sink) override;
+  MTAPIRES TickUnsubscribe(IMTTickSink* sink) override;
+  MTAPIRES TickAdd(MTTick& tick) override;
+  MTAPIRES TickLast(LPCWSTR symbol, MTTickShort& tick) override;
+  MTAPIRES TickLast(const IMTConSymbol* symbol, MTTickShort& tick) override;
+
+private:
+  template<typename SinkT>
+  static MTAPIRES Subscribe(std::vector<SinkT*>& sinks, SinkT* sink);
+  template<typename SinkT>
+  static MTAPIRES Unsubscribe(std::vector<SinkT*>& sinks, SinkT* sink);
+
+  // Configuration.
+  FakeConPlugin plugin_;
+  std::vector<FakeConFeeder> feeders_;
+  std::vector<FakeConSymbol> symbols_;
+  std::vector<FakeConServer> servers_;
+  std::vector<FakeConHoliday> holidays_;
+
+  // Subscribers.
+  std::vector<IMTConPluginSink*> plugin_sinks_;
+  std::vector<IMTConServerSink*> server_sinks_;
+  std::vector<IMTConFeederSink*> feeder_sinks_;
+  std::vector<IMTConSymbolSink*> symbol_sinks_;
+  std::vector<IMTConHolidaySink*> holiday_sinks_;
+  std::vector<IMTTickSink*> tick_sinks_;
+
+  // Clock.
+  std::atomic<INT64> time_msc_;
+
+  // Last ticks, protected by |tick_last_mutex_|.
+  std::unordered_map<std::wstring, MTTickShort> last_ticks_;
+  std::atomic<UINT> tick_last_latency_us_;
+  mutable std::mutex tick_last_mutex_;
+
+  // Spread filter of symbols which have one (points, 0 if unbounded),
+  // checked by |TickAdd| as the server filters. Protected by
+  // |config_mutex_|.
+  struct SpreadFilter {
+    double point = 0;
+    UINT min = 0;
+    UINT max = 0;
+  };
+  std::unordered_map<std::wstring, SpreadFilter> spread_filters_;
+  std::atomic<bool> has_spread_filters_;
+
+  // Statistics.
+  std::atomic<UINT64> ticks_added_;
+  std::atomic<UINT64> ticks_rejected_;
+
+  // Protects configuration and subscribers. Ticks are dispatched without
+  // holding it, subscriptions are expected to change only on start/stop.
+  mutable std::mutex config_mutex_;
+};
@@ -0,0 +1,2 @@
+#pragma once
+// SDKDDKVer.h : no Windows platform selection on Linux.
@@ -0,0 +1,4 @@
+// MT5APIFile.h : CMTFile is not available in the Linux host build.
+// The plugin does not use it; the SDK version depends on Win32 file APIs.
+
+#pragma once
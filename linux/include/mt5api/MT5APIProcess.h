@@ -0,0 +1,4 @@
+// MT5APIProcess.h : CMTProcess is not available in the Linux host build.
+// The plugin does not use it; the SDK version depends on Win32 process APIs.
+
+#pragma once
@@ -0,0 +1,19 @@
+// MT5APISync.h : portable replacement of the SDK CMTSync class.
+// Same interface as "Classes\MT5APISync.h", backed by std::mutex.
+
+#pragma once
+
+#include <mutex>
+
+class CMTSync {
+public:
+  CMTSync(void) = default;
+  ~CMTSync(void) = default;
+
+  inline void Lock(void) { mutex_.lock(); }
+  inline void Unlock(void) { mutex_.unlock(); }
+  inline bool TryLock(void) { return mutex_.try_lock(); }
+
+private:
+  std::mutex mutex_;
+};
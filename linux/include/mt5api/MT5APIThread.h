@@ -0,0 +1,30 @@
+// MT5APIThread.h : portable replacement of the SDK CMTThread class.
+// Same interface as "Classes\MT5APIThread.h", backed by std::thread.
+// Timeouts, termination and priorities are not supported.
+
+#pragma once
+
+#include <thread>
+
+class CMTThread {
+public:
+  CMTThread(void) = default;
+  ~CMTThread(void) { Shutdown(); }
+
+  inline bool Start(unsigned (__stdcall *thread_func)(void*),
+                    void *thread_param, const UINT /*stack_size*/) {
+    if (thread_.joinable()) return false;
+    thread_ = std::thread(thread_func, thread_param);
+    return true;
+  }
+  inline bool Shutdown(const UINT /*timeout*/ = INFINITE) {
+    if (thread_.joinable()) thread_.join();
+    return true;
+  }
+  inline void Terminate(void) { Shutdown(); }
+  inline bool IsBusy(void) { return thread_.joinable(); }
+  inline bool Priority(int /*priority*/) { return false; }
+
+private:
+  std::thread thread_;
+};
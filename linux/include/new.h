@@ -0,0 +1,3 @@
+#pragma once
+// new.h : MSVC name of <new>.
+#include <new>
@@ -0,0 +1,2 @@
+#pragma once
+// process.h : threads are provided by the portable MT5APIThread.h.
@@ -0,0 +1,2 @@
+#pragma once
+// sys/timeb.h : not used by the Linux host build.
@@ -0,0 +1,8 @@
+#pragma once
+// tchar.h : generic-text mappings used by log.h.
+
+#ifdef _UNICODE
+#define _T(x) L##x
+#else
+#define _T(x) x
+#endif
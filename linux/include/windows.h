@@ -0,0 +1,252 @@
+// windows.h : minimal stand-in for the Win32 header on Linux.
+// Declares only the types, macros and CRT/Win32 functions that are
+// referenced by "MT5APIServer.h" and the plugin sources, so the plugin
+// can be compiled and exercised against the fake server host.
+// Nothing here talks to a real Windows API: file, process and error
+// message functions report failure.
+
+#pragma once
+
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <cwchar>
+#include <cwctype>
+#include <string>
+
+#include <unistd.h>
+
+// Basic types.
+typedef int                BOOL;
+typedef unsigned char      BYTE;
+typedef unsigned char      UCHAR;
+typedef unsigned short     WORD;
+typedef unsigned short     USHORT;
+typedef short              SHORT;
+typedef unsigned int       UINT;
+typedef unsigned int       DWORD;
+typedef unsigned int       ULONG;
+typedef int                INT;
+typedef int                LONG;
+typedef int                INT32;
+typedef unsigned int       UINT32;
+typedef DWORD              COLORREF;
+typedef char               CHAR;
+typedef wchar_t            WCHAR;
+typedef long long          INT64;
+typedef unsigned long long UINT64;
+typedef long long          LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef long long          __int64;
+typedef char*              LPSTR;
+typedef const char*        LPCSTR;
+typedef wchar_t*           LPWSTR;
+typedef const wchar_t*     LPCWSTR;
+typedef void*              LPVOID;
+typedef const void*        LPCVOID;
+typedef void*              HANDLE;
+typedef void*              HMODULE;
+typedef std::uintptr_t     UINT_PTR;
+typedef std::intptr_t      INT_PTR;
+typedef std::uintptr_t     ULONG_PTR;
+typedef std::size_t        SIZE_T;
+
+#ifdef _UNICODE
+typedef wchar_t            TCHAR;
+#else
+typedef char               TCHAR;
+#endif
+
+#ifndef TRUE
+#define TRUE  1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+#ifndef MAX_PATH
+#define MAX_PATH 260
+#endif
+
+// Calling conventions and storage classes.
+#define __cdecl
+#define __stdcall
+#define WINAPI
+#define APIENTRY
+#define __declspec(x) __declspec_##x
+#define __declspec_dllexport __attribute__((visibility("default")))
+#define __declspec_selectany __attribute__((weak))
+#define __declspec_novtable
+
+#define _I64_MAX LLONG_MAX
+#define _I64_MIN LLONG_MIN
+
+// MSVC integer literal suffix (0x7fffffffi64).
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wliteral-suffix"
+constexpr INT64 operator"" i64(unsigned long long value) { return static_cast<INT64>(value); }
+#pragma GCC diagnostic pop
+
+#define _countof(array) (sizeof(array) / sizeof((array)[0]))
+#define ZeroMemory(dst, len) std::memset((dst), 0, (len))
+
+// Structures.
+struct SYSTEMTIME {
+  WORD wYear;
+  WORD wMonth;
+  WORD wDayOfWeek;
+  WORD wDay;
+  WORD wHour;
+  WORD wMinute;
+  WORD wSecond;
+  WORD wMilliseconds;
+};
+
+// DLL entry point notifications.
+#define DLL_PROCESS_DETACH 0
+#define DLL_PROCESS_ATTACH 1
+#define DLL_THREAD_ATTACH  2
+#define DLL_THREAD_DETACH  3
+
+// Error codes.
+#define ERROR_SUCCESS             0
+#define ERROR_INSUFFICIENT_BUFFER 122
+#define INFINITE                  0xFFFFFFFF
+
+inline DWORD GetLastError() { return ERROR_SUCCESS; }
+
+// Code pages and system message formatting.
+#define CP_ACP                        0
+#define CP_UTF8                       65001
+#define FORMAT_MESSAGE_IGNORE_INSERTS 0x00000200
+#define FORMAT_MESSAGE_FROM_SYSTEM    0x00001000
+#define LANG_ENGLISH                  0x09
+#define SUBLANG_ENGLISH_US            0x01
+#define MAKELANGID(p, s)              ((((WORD)(s)) << 10) | (WORD)(p))
+
+inline int MultiByteToWideChar(UINT, DWORD, LPCSTR src, int src_len,
+                               LPWSTR dst, int dst_len) {
+  int len = 0;
+  for (; (src_len < 0 || len < src_len) && len < dst_len; len++) {
+    dst[len] = static_cast<unsigned char>(src[len]);
+    if (src[len] == 0) return len + 1;
+  }
+  return len;
+}
+
+inline int WideCharToMultiByte(UINT, DWORD, LPCWSTR src, int src_len,
+                               LPSTR dst, int dst_len, LPCSTR, BOOL*) {
+  int len = 0;
+  for (; (src_len < 0 || len < src_len) && len < dst_len; len++) {
+    dst[len] = static_cast<char>(src[len]);
+    if (src[len] == 0) return len + 1;
+  }
+  return len;
+}
+
+inline DWORD FormatMessageW(DWORD, LPCVOID, DWORD, DWORD, LPWSTR buffer,
+                            DWORD size, va_list*) {
+  if (buffer && size) buffer[0] = L'\0';
+  return 0;
+}
+
+inline DWORD GetModuleFileNameW(HMODULE, LPWSTR path, DWORD size) {
+  char buffer[MAX_PATH] = { 0 };
+  ssize_t len = readlink("/proc/self/exe", buffer, sizeof(buffer) - 1);
+  if (len < 0) len = 0;
+  DWORD i = 0;
+  for (; i < static_cast<DWORD>(len) && i + 1 < size; i++)
+    path[i] = static_cast<unsigned char>(buffer[i]);
+  if (size) path[i] = L'\0';
+  return i;
+}
+#define GetModuleFileName GetModuleFileNameW
+
+// Secure CRT string functions.
+#define _TRUNCATE ((std::size_t)-1)
+typedef int errno_t;
+
+inline errno_t wcsncpy_s(wchar_t* dst, std::size_t dst_size,
+                         const wchar_t* src, std::size_t count) {
+  if (!dst || !dst_size) return EINVAL;
+  std::size_t i = 0;
+  for (; i + 1 < dst_size && i < count && src && src[i]; i++)
+    dst[i] = src[i];
+  dst[i] = L'\0';
+  return 0;
+}
+
+inline errno_t _wcslwr_s(wchar_t* str, std::size_t size) {
+  for (std::size_t i = 0; str && i < size && str[i]; i++)
+    str[i] = static_cast<wchar_t>(std::towlower(str[i]));
+  return 0;
+}
+
+inline errno_t _wcsupr_s(wchar_t* str, std::size_t size) {
+  for (std::size_t i = 0; str && i < size && str[i]; i++)
+    str[i] = static_cast<wchar_t>(std::towupper(str[i]));
+  return 0;
+}
+
+inline int _wcsnicmp(const wchar_t* left, const wchar_t* right, std::size_t count) {
+  for (std::size_t i = 0; i < count; i++) {
+    wint_t l = std::towlower(left[i]), r = std::towlower(right[i]);
+    if (l != r) return l < r ? -1 : 1;
+    if (l == 0) break;
+  }
+  return 0;
+}
+
+inline int _wcsicmp(const wchar_t* left, const wchar_t* right) {
+  return _wcsnicmp(left, right, static_cast<std::size_t>(-1));
+}
+
+// Microsoft wide printf treats %s/%c as wide and knows %I64; glibc does not.
+inline std::wstring TranslateWideFormat(const wchar_t* fmt) {
+  std::wstring out;
+  for (const wchar_t* p = fmt; *p; p++) {
+    out += *p;
+    if (*p != L'%') continue;
+    if (p[1] == L'%') { out += *++p; continue; }
+    while (p[1] && std::wcschr(L"-+ #0123456789.*", p[1])) out += *++p;
+    if (p[1] == L'I' && p[2] == L'6' && p[3] == L'4') { out += L"ll"; p += 3; }
+    else if ((p[1] == L's' || p[1] == L'c' || p[1] == L'S' || p[1] == L'C')) out += L'l';
+  }
+  return out;
+}
+
+inline int _vsnwprintf_s(wchar_t* dst, std::size_t dst_size, std::size_t count,
+                         const wchar_t* fmt, va_list args) {
+  if (!dst || !dst_size) return -1;
+  std::size_t limit = count == _TRUNCATE || count + 1 > dst_size ? dst_size : count + 1;
+  int len = std::vswprintf(dst, limit, TranslateWideFormat(fmt).c_str(), args);
+  if (len < 0) { dst[limit - 1] = L'\0'; return -1; }
+  return len;
+}
+
+inline int _snwprintf_s(wchar_t* dst, std::size_t dst_size, std::size_t count,
+                        const wchar_t* fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  int len = _vsnwprintf_s(dst, dst_size, count, fmt, args);
+  va_end(args);
+  return len;
+}
+
+// 64-bit time functions.
+typedef long long __time64_t;
+
+inline errno_t _gmtime64_s(struct tm* result, const __time64_t* time) {
+  time_t t = static_cast<time_t>(*time);
+  return gmtime_r(&t, result) ? 0 : EINVAL;
+}
+
+inline __time64_t _mkgmtime64(struct tm* time) {
+  return static_cast<__time64_t>(timegm(time));
+}
@@ -0,0 +1,3 @@
+#pragma once
+// winnls.h : code page functions are declared in windows.h.
+#include "windows.h"
@@ -0,0 +1,447 @@
+// tick_replay.cpp : load generator for the Nonstop Rate plugin.
+//
+// Replays synthetic or recorded tick streams into the plugin hooks from
+// several threads, as the history server does, and reports throughput,
+// per-call latency of the tick hook and the number of fake ticks the
+// plugin added.
+//
+// Ex:
+//    tick_replay --symbols=5000 --threads=8 --rate=200000 --duration=10
+//    tick_replay --feeders=4 --feeder-shift=0.5 --outage-after=5
+//    tick_replay --symbols=10000 --reload=0.2
+//    tick_replay --log-level=WARNING
+//    tick_replay --replay=ticks.csv --threads=4 --rate=0
+//
+// Recorded streams are CSV files with one tick per line:
+//    feeder,symbol,bid,ask
+// where |feeder| is the hook feeder index (-1 dealer, 0..63 gateways,
+// 64.. datafeeds).
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "fake_server_api.h"
+#include "log.h"
+#include "nonstop_rate_plugin.h"
+
+MTAPIENTRY MTAPIRES MTServerCreate(UINT apiversion, IMTServerPlugin **plugin);
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Name of the datafeed configured as plugin main feed. Other datafeeds
+// are named "Backup1", "Backup2", ...
+const wchar_t kMainFeed[] = L"Main";
+
+// Maximum number of "NN.Symbols" plugin parameters.
+const int kMaxSymbolParams = 99;
+
+// Feeder index returned by |PickFeeder| for main feed ticks lost in an outage.
+const int kLostTick = -2;
+
+// Latency samples kept per thread.
+const size_t kMaxSamplesPerThread = 4 * 1024 * 1024;
+
+struct Options {
+  int symbols = 2000;
+  int threads = 4;
+  // Total ticks per second, 0 means as fast as possible.
+  int rate = 100000;
+  double duration = 10;
+  // Number of configured datafeeds, the first one is the main feed.
+  int feeders = 2;
+  // Share of ticks in percents by source.
+  double dealer_share = 1;
+  double gateway_share = 1;
+  double backup_share = 10;
+  // Stop main feed ticks after this many seconds (< 0: never).
+  double outage_after = -1;
+  // Move the main feed to another position every this many seconds,
+  // as an administrator reordering datafeeds (<= 0: never).
+  double feeder_shift = -1;
+  // Reload plugin parameters every this many seconds, as an administrator
+  // editing them (<= 0: never).
+  double reload = -1;
+  // Plugin timeout parameter (seconds).
+  int timeout = 5;
+  // Plugin log level parameter, empty to keep the default.
+  std::string log_level;
+  // Recorded stream, synthetic ticks are generated when empty.
+  std::string replay;
+};
+
+struct RecordedTick {
+  int feeder;
+  std::wstring symbol;
+  double bid;
+  double ask;
+};
+
+// Statistics collected by one replay thread.
+struct ThreadStats {
+  UINT64 ticks = 0;
+  std::vector<UINT64> latencies_ns;
+};
+
+bool ParseOption(const std::string& arg, const char* name, std::string& value) {
+  std::string prefix = std::string("--") + name + "=";
+  if (arg.compare(0, prefix.size(), prefix) != 0)
+    return false;
+  value = arg.substr(prefix.size());
+  return true;
+}
+
+bool ParseOptions(int argc, char* argv[], Options& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i], value;
+    if (ParseOption(arg, "symbols", value)) options.symbols = std::stoi(value);
+    else if (ParseOption(arg, "threads", value)) options.threads = std::stoi(value);
+    else if (ParseOption(arg, "rate", value)) options.rate = std::stoi(value);
+    else if (ParseOption(arg, "duration", value)) options.duration = std::stod(value);
+    else if (ParseOption(arg, "feeders", value)) options.feeders = std::stoi(value);
+    else if (ParseOption(arg, "dealer-share", value)) options.dealer_share = std::stod(value);
+    else if (ParseOption(arg, "gateway-share", value)) options.gateway_share = std::stod(value);
+    else if (ParseOption(arg, "backup-share", value)) options.backup_share = std::stod(value);
+    else if (ParseOption(arg, "outage-after", value)) options.outage_after = std::stod(value);
+    else if (ParseOption(arg, "feeder-shift", value)) options.feeder_shift = std::stod(value);
+    else if (ParseOption(arg, "reload", value)) options.reload = std::stod(value);
+    else if (ParseOption(arg, "timeout", value)) options.timeout = std::stoi(value);
+    else if (ParseOption(arg, "log-level", value)) options.log_level = value;
+    else if (ParseOption(arg, "replay", value)) options.replay = value;
+    else {
+      std::fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+      return false;
+    }
+  }
+
+  options.symbols = std::max(options.symbols, 1);
+  options.threads = std::max(options.threads, 1);
+  options.feeders = std::max(options.feeders, 1);
+  return true;
+}
+
+std::wstring SymbolName(int index) {
+  wchar_t name[32];
+  std::swprintf(name, 32, L"SYM%05d", index);
+  return name;
+}
+
+bool LoadRecordedTicks(const std::string& path, std::vector<RecordedTick>& ticks) {
+  std::ifstream file(path);
+  if (!file)
+    return false;
+
+  std::string line;
+  while (std::getline(file, line)) {
+    std::vector<std::string> fields;
+    std::stringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, ','))
+      fields.push_back(field);
+    if (fields.size() < 4)
+      continue;
+
+    RecordedTick tick;
+    tick.feeder = std::stoi(fields[0]);
+    tick.symbol.assign(fields[1].begin(), fields[1].end());
+    tick.bid = std::stod(fields[2]);
+    tick.ask = std::stod(fields[3]);
+    ticks.push_back(tick);
+  }
+  return !ticks.empty();
+}
+
+// Configure the fake server: datafeeds, symbols and plugin parameters.
+void ConfigureServer(FakeServerAPI& server, const Options& options,
+                     const std::vector<std::wstring>& symbols) {
+  server.AddFeeder(kMainFeed);
+  for (int i = 1; i < options.feeders; i++)
+    server.AddFeeder((L"Backup" + std::to_wstring(i)).c_str());
+
+  for (auto& symbol : symbols)
+    server.AddSymbol(symbol.c_str(), 5);
+
+  server.SetPluginParameter(TIMEOUT_PARAM_NAME, std::to_wstring(options.timeout).c_str());
+  server.SetPluginParameter(FEEDER_PARAM_NAME, kMainFeed);
+  if (!options.log_level.empty()) {
+    std::wstring log_level(options.log_level.begin(), options.log_level.end());
+    server.SetPluginParameter(LOG_LEVEL_PARAM_NAME, log_level.c_str());
+  }
+
+  // Spread symbols over "NN.Symbols" parameters.
+  size_t params = std::min<size_t>(kMaxSymbolParams, symbols.size());
+  size_t per_param = (symbols.size() + params - 1) / params;
+  for (size_t param = 0; param * per_param < symbols.size(); param++) {
+    std::wstring value;
+    for (size_t i = param * per_param; i < std::min(symbols.size(), (param + 1) * per_param); i++)
+      value += symbols[i] + L",";
+    if (!value.empty()) value.pop_back();
+
+    wchar_t name[16];
+    std::swprintf(name, 16, L"%02zu.Symbols", param + 1);
+    server.SetPluginParameter(name, value.c_str());
+  }
+}
+
+// Position of the main feed in the datafeeds list.
+std::atomic<int> main_feeder_pos(0);
+
+// Pick the feeder index of a synthetic tick according to source shares.
+int PickFeeder(const Options& options, std::mt19937& engine, bool main_feed_down) {
+  std::uniform_real_distribution<double> percent(0, 100);
+  double value = percent(engine);
+  if ((value -= options.dealer_share) < 0)
+    return MT_FEEDER_DEALER;
+  if ((value -= options.gateway_share) < 0)
+    return std::uniform_int_distribution<int>(0, MT_FEEDER_OFFSET - 1)(engine);
+  int main_pos = main_feeder_pos;
+  if (options.feeders > 1 && (value -= options.backup_share) < 0) {
+    int pos = std::uniform_int_distribution<int>(0, options.feeders - 2)(engine);
+    return MT_FEEDER_OFFSET + (pos >= main_pos ? pos + 1 : pos);
+  }
+  return main_feed_down ? kLostTick : MT_FEEDER_OFFSET + main_pos;
+}
+
+// Replay thread: sends ticks of its own symbols (so that per-symbol order
+// is preserved) at |rate| ticks per second until |stop| is set.
+void ReplayThread(FakeServerAPI& server, const Options& options, int index,
+                  const std::vector<std::wstring>& symbols,
+                  const std::vector<RecordedTick>& recorded,
+                  double rate, Clock::time_point start,
+                  const std::atomic<bool>& stop, ThreadStats& stats) {
+  std::mt19937 engine(index + 1);
+  std::vector<double> prices(symbols.size(), 1.0);
+
+  // Symbols and recorded ticks owned by this thread.
+  std::vector<size_t> own_symbols;
+  for (size_t i = index; i < symbols.size(); i += options.threads)
+    own_symbols.push_back(i);
+  std::vector<const RecordedTick*> own_ticks;
+  for (auto& tick : recorded)
+    if (std::hash<std::wstring>()(tick.symbol) % options.threads == static_cast<size_t>(index))
+      own_ticks.push_back(&tick);
+  if (recorded.empty() ? own_symbols.empty() : own_ticks.empty())
+    return;
+
+  std::uniform_real_distribution<double> move(-0.0002, 0.0002);
+  UINT64 sent = 0;
+  while (!stop) {
+    auto now = Clock::now();
+    double elapsed = std::chrono::duration<double>(now - start).count();
+    // Throttle to the target rate.
+    if (rate > 0 && sent >= elapsed * rate) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    MTTick tick = {};
+    int feeder;
+    if (recorded.empty()) {
+      size_t symbol = own_symbols[sent % own_symbols.size()];
+      bool main_feed_down = options.outage_after >= 0 && elapsed >= options.outage_after;
+      if ((feeder = PickFeeder(options, engine, main_feed_down)) == kLostTick) {
+        // Main feed is down, the tick is lost.
+        sent++;
+        continue;
+      }
+      prices[symbol] += move(engine);
+      CMTStr::Copy(tick.symbol, _countof(tick.symbol), symbols[symbol].c_str());
+      tick.bid = prices[symbol];
+      tick.ask = prices[symbol] + 0.0002;
+    } else {
+      const RecordedTick& recorded_tick = *own_ticks[sent % own_ticks.size()];
+      feeder = recorded_tick.feeder;
+      CMTStr::Copy(tick.symbol, _countof(tick.symbol), recorded_tick.symbol.c_str());
+      tick.bid = recorded_tick.bid;
+      tick.ask = recorded_tick.ask;
+    }
+    tick.datetime_msc = server.TimeCurrentMsc();
+    tick.datetime = tick.datetime_msc / 1000;
+
+    auto begin = Clock::now();
+    server.FeedTick(feeder, tick);
+    auto end = Clock::now();
+
+    if (stats.latencies_ns.size() < kMaxSamplesPerThread)
+      stats.latencies_ns.push_back(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+    stats.ticks++;
+    sent++;
+  }
+}
+
+UINT64 Percentile(const std::vector<UINT64>& sorted, double percentile) {
+  if (sorted.empty())
+    return 0;
+  size_t index = static_cast<size_t>(percentile / 100 * (sorted.size() - 1));
+  return sorted[index];
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, options))
+    return 1;
+
+  std::vector<RecordedTick> recorded;
+  if (!options.replay.empty() && !LoadRecordedTicks(options.replay, recorded)) {
+    std::fprintf(stderr, "Cannot load recorded ticks from %s\n", options.replay.c_str());
+    return 1;
+  }
+
+  // Symbols: all symbols of the recording, or synthetic ones.
+  std::vector<std::wstring> symbols;
+  if (recorded.empty()) {
+    for (int i = 0; i < options.symbols; i++)
+      symbols.push_back(SymbolName(i));
+  } else {
+    for (auto& tick : recorded)
+      symbols.push_back(tick.symbol);
+    std::sort(symbols.begin(), symbols.end());
+    symbols.erase(std::unique(symbols.begin(), symbols.end()), symbols.end());
+  }
+
+  // Start from an empty snapshot, it is kept in "bases" next to the executable.
+  std::error_code error;
+  std::filesystem::remove(std::filesystem::read_symlink("/proc/self/exe").parent_path() /
+                          "bases" / "NonstopRate.snapshot", error);
+
+  FakeServerAPI server;
+  ConfigureServer(server, options, symbols);
+
+  IMTServerPlugin* plugin = nullptr;
+  if (MTServerCreate(MTServerAPIVersion, &plugin) != MT_RET_OK ||
+      server.StartPlugin(plugin) != MT_RET_OK) {
+    std::fprintf(stderr, "Cannot start plugin\n");
+    return 1;
+  }
+
+  // Server clock follows the real time during the run.
+  std::atomic<bool> stop(false);
+  auto start = Clock::now();
+  INT64 start_time_msc = server.TimeCurrentMsc();
+  std::thread clock_thread([&]() {
+    while (!stop) {
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+      server.SetTimeMsc(start_time_msc + elapsed.count());
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+
+  std::vector<ThreadStats> stats(options.threads);
+  std::vector<std::thread> threads;
+  double thread_rate = static_cast<double>(options.rate) / options.threads;
+  for (int i = 0; i < options.threads; i++)
+    threads.emplace_back(ReplayThread, std::ref(server), std::cref(options), i,
+                         std::cref(symbols), std::cref(recorded), thread_rate,
+                         start, std::cref(stop), std::ref(stats[i]));
+
+  auto end = start + std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(options.duration));
+
+  // Edit plugin parameters under load, the timeout alternates so every
+  // reload changes the configuration.
+  UINT reloads = 0;
+  std::thread reload_thread([&]() {
+    while (options.reload > 0) {
+      auto next = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double>(options.reload));
+      if (next >= end)
+        break;
+      std::this_thread::sleep_until(next);
+
+      int timeout = options.timeout + (reloads % 2 ? 0 : 1);
+      server.SetPluginParameter(TIMEOUT_PARAM_NAME, std::to_wstring(timeout).c_str());
+      server.NotifyPluginUpdate();
+      reloads++;
+    }
+  });
+
+  // Reorder datafeeds under load: move the main feed one position further.
+  UINT feeder_shifts = 0;
+  while (options.feeder_shift > 0 && options.feeders > 1) {
+    auto next = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(options.feeder_shift));
+    if (next >= end)
+      break;
+    std::this_thread::sleep_until(next);
+
+    int pos = main_feeder_pos;
+    int shift = pos + 1 < options.feeders ? 1 : -pos;
+    if (server.FeederShift(pos, shift) == MT_RET_OK) {
+      main_feeder_pos = pos + shift;
+      feeder_shifts++;
+    }
+  }
+  std::this_thread::sleep_until(end);
+  reload_thread.join();
+  stop = true;
+  for (auto& thread : threads)
+    thread.join();
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  clock_thread.join();
+
+  UINT64 fake_ticks = server.TicksAdded();
+  server.StopPlugin(plugin);
+  // Latencies measured by the plugin itself.
+  LatencyHistogram::Snapshot plugin_latency[NonstopRatePlugin::LATENCY_METRIC_NUM];
+  for (int i = 0; i < NonstopRatePlugin::LATENCY_METRIC_NUM; i++) {
+    static_cast<NonstopRatePlugin*>(plugin)->Latency(
+        static_cast<NonstopRatePlugin::LatencyMetric>(i), plugin_latency[i]);
+  }
+  plugin->Release();
+
+  // Report.
+  UINT64 ticks = 0;
+  std::vector<UINT64> latencies;
+  for (auto& it : stats) {
+    ticks += it.ticks;
+    latencies.insert(latencies.end(), it.latencies_ns.begin(), it.latencies_ns.end());
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  std::printf("symbols:        %zu\n", symbols.size());
+  std::printf("threads:        %d\n", options.threads);
+  std::printf("duration:       %.2f s\n", elapsed);
+  std::printf("ticks:          %llu\n", ticks);
+  std::printf("throughput:     %.0f ticks/s\n", ticks / elapsed);
+  std::printf("hook p50:       %llu ns\n", Percentile(latencies, 50));
+  std::printf("hook p99:       %llu ns\n", Percentile(latencies, 99));
+  std::printf("hook p99.9:     %llu ns\n", Percentile(latencies, 99.9));
+  std::printf("hook max:       %llu ns\n", latencies.empty() ? 0ULL : latencies.back());
+  for (int i = 0; i < NonstopRatePlugin::LATENCY_METRIC_NUM; i++) {
+    const LatencyHistogram::Snapshot& latency = plugin_latency[i];
+    std::printf("%-15s count=%llu p50=%llu p99=%llu p99.9=%llu max=%llu ns\n",
+                NonstopRatePlugin::LatencyName(static_cast<NonstopRatePlugin::LatencyMetric>(i)),
+                static_cast<unsigned long long>(latency.count),
+                static_cast<unsigned long long>(latency.Percentile(50)),
+                static_cast<unsigned long long>(latency.Percentile(99)),
+                static_cast<unsigned long long>(latency.Percentile(99.9)),
+                static_cast<unsigned long long>(latency.Max()));
+  }
+  // Every replayed tick and every fake tick went through the hook.
+  if (plugin_latency[NonstopRatePlugin::LATENCY_HOOK_TICK].count < ticks + fake_ticks)
+    std::printf("plugin counted fewer hook calls than ticks\n");
+  std::printf("fake ticks:     %llu\n", fake_ticks);
+  std::printf("feeder shifts:  %u\n", feeder_shifts);
+  std::printf("reloads:        %u\n", reloads);
+  LogEngine::Stats log_stats = LogEngine::GetStats();
+  std::printf("log written:    %llu\n", static_cast<unsigned long long>(log_stats.written));
+  std::printf("log dropped:    %llu\n", static_cast<unsigned long long>(log_stats.dropped));
+  std::printf("log blocked:    %llu\n", static_cast<unsigned long long>(log_stats.blocked));
+  return 0;
+}
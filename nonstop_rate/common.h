@@ -1,17 +1,174 @@
 #pragma once
 
+#include <cwctype>
+#include <iterator>
+#include <string>
+#include <string_view>
 #include <vector>
 
-#define TIMEOUT_PARAM_NAME L"01.Timeout(seconds)"
+#define TIMEOUT_PARAM_NAME L"01.Timeout"
 #define FEEDER_PARAM_NAME L"02.Feeder"
 #define SYMBOLS_PARAM_NAME L"03.Symbols"
+#define LOG_LEVEL_PARAM_NAME L"04.LogLevel"
+#define SNAPSHOT_MAX_AGE_PARAM_NAME L"05.SnapshotMaxAge(seconds)"
+#define PRICE_MODELS_PARAM_NAME L"06.PriceModels"
+#define PROCESSING_MARGIN_PARAM_NAME L"07.ProcessingMargin"
+#define USE_QUOTES_TIMEOUT_PARAM_NAME L"08.UseQuotesTimeout"
+// Name of the timeout parameter when it only took seconds, still read.
+#define LEGACY_TIMEOUT_PARAM_NAME L"01.Timeout(seconds)"
 
+// String helpers for both std::string and std::wstring. They work on
+// string views and return parts of their argument, nothing is allocated
+// except by |Split|, so the viewed string must outlive the results.
 namespace common {
 
-// Split string.
-std::vector<std::wstring> Split(const std::wstring& s, wchar_t delim = L' ');
+inline bool IsExtendedSpace(char) { return false; }
+inline bool IsExtendedSpace(wchar_t c) { return std::iswspace(c) != 0; }
+
+// White space check. ASCII characters, which make up nearly all parameters,
+// are checked without the locale lookup of std::isspace/std::iswspace.
+template<typename CharT>
+bool IsSpace(CharT c) {
+  if (static_cast<unsigned long>(c) < 0x80)
+    return c == CharT(' ') || (c >= CharT('\t') && c <= CharT('\r'));
+  return IsExtendedSpace(c);
+}
 
 // Trim from both start and end of string.
-std::wstring Trim(const std::wstring &s);
+template<typename CharT>
+std::basic_string_view<CharT> Trim(std::basic_string_view<CharT> s) {
+  size_t begin = 0, end = s.size();
+  while (begin < end && IsSpace(s[begin]))
+    begin++;
+  while (end > begin && IsSpace(s[end - 1]))
+    end--;
+  return s.substr(begin, end - begin);
+}
+template<typename CharT>
+std::basic_string_view<CharT> Trim(const CharT* s) {
+  return Trim(std::basic_string_view<CharT>(s));
+}
+template<typename CharT>
+std::basic_string_view<CharT> Trim(const std::basic_string<CharT>& s) {
+  return Trim(std::basic_string_view<CharT>(s));
+}
+// The result would outlive a temporary string.
+template<typename CharT>
+std::basic_string_view<CharT> Trim(std::basic_string<CharT>&& s) = delete;
+
+// Lazy split: iterates over the parts of a string separated by |delim|,
+// as views of the string. Empty parts are kept, an empty string has one
+// empty part.
+// Ex:
+//    for (std::wstring_view item : common::SplitView(value, L','))
+//      Use(common::Trim(item));
+template<typename CharT>
+class SplitRange {
+public:
+  using view = std::basic_string_view<CharT>;
+
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const view*;
+    using reference = view;
+
+    // End of any range.
+    iterator() : begin_(nullptr), item_end_(nullptr), end_(nullptr), delim_() {}
+
+    view operator*() const { return view(begin_, item_end_ - begin_); }
+
+    iterator& operator++() {
+      if (item_end_ == end_) {
+        begin_ = nullptr;
+      } else {
+        begin_ = item_end_ + 1;
+        FindItemEnd();
+      }
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator it = *this;
+      ++*this;
+      return it;
+    }
+
+    bool operator==(const iterator& other) const { return begin_ == other.begin_; }
+    bool operator!=(const iterator& other) const { return begin_ != other.begin_; }
+
+  private:
+    friend class SplitRange;
+
+    iterator(const CharT* begin, const CharT* end, CharT delim)
+        : begin_(begin), end_(end), delim_(delim) {
+      FindItemEnd();
+    }
+
+    void FindItemEnd() {
+      item_end_ = begin_;
+      while (item_end_ != end_ && *item_end_ != delim_)
+        item_end_++;
+    }
+
+    // Current part is [begin_, item_end_), nullptr |begin_| after the last.
+    const CharT* begin_;
+    const CharT* item_end_;
+    const CharT* end_;
+    CharT delim_;
+  };
+
+  SplitRange(view s, CharT delim) : s_(s), delim_(delim) {}
+
+  iterator begin() const {
+    // An empty string still has one empty part, which needs a position.
+    static const CharT kEmpty = CharT();
+    const CharT* data = s_.data() ? s_.data() : &kEmpty;
+    return iterator(data, data + s_.size(), delim_);
+  }
+  iterator end() const { return iterator(); }
+
+private:
+  view s_;
+  CharT delim_;
+};
+
+template<typename CharT>
+SplitRange<CharT> SplitView(std::basic_string_view<CharT> s, CharT delim = CharT(' ')) {
+  return SplitRange<CharT>(s, delim);
+}
+template<typename CharT>
+SplitRange<CharT> SplitView(const CharT* s, CharT delim = CharT(' ')) {
+  return SplitRange<CharT>(s, delim);
+}
+template<typename CharT>
+SplitRange<CharT> SplitView(const std::basic_string<CharT>& s, CharT delim = CharT(' ')) {
+  return SplitRange<CharT>(s, delim);
+}
+template<typename CharT>
+SplitRange<CharT> SplitView(std::basic_string<CharT>&& s, CharT delim = CharT(' ')) = delete;
+
+// Split string, all parts at once.
+template<typename CharT>
+std::vector<std::basic_string_view<CharT>> Split(std::basic_string_view<CharT> s,
+                                                 CharT delim = CharT(' ')) {
+  std::vector<std::basic_string_view<CharT>> ret;
+  for (auto item : SplitView(s, delim))
+    ret.push_back(item);
+  return ret;
+}
+template<typename CharT>
+std::vector<std::basic_string_view<CharT>> Split(const CharT* s, CharT delim = CharT(' ')) {
+  return Split(std::basic_string_view<CharT>(s), delim);
+}
+template<typename CharT>
+std::vector<std::basic_string_view<CharT>> Split(const std::basic_string<CharT>& s,
+                                                 CharT delim = CharT(' ')) {
+  return Split(std::basic_string_view<CharT>(s), delim);
+}
+template<typename CharT>
+std::vector<std::basic_string_view<CharT>> Split(std::basic_string<CharT>&& s,
+                                                 CharT delim = CharT(' ')) = delete;
 
 }
@@ -17,9 +17,14 @@ MTPluginInfo plugin_info = {
 
 // Plugin default parameters.
 MTPluginParam plugin_default_params[] = {
-  { MTPluginParam::TYPE_INT, TIMEOUT_PARAM_NAME, L"30" },
+  { MTPluginParam::TYPE_STRING, TIMEOUT_PARAM_NAME, L"30" },
   { MTPluginParam::TYPE_STRING, FEEDER_PARAM_NAME, L"" },
   { MTPluginParam::TYPE_STRING, SYMBOLS_PARAM_NAME, L"" },
+  { MTPluginParam::TYPE_STRING, LOG_LEVEL_PARAM_NAME, L"INFO" },
+  { MTPluginParam::TYPE_STRING, SNAPSHOT_MAX_AGE_PARAM_NAME, L"300" },
+  { MTPluginParam::TYPE_STRING, PRICE_MODELS_PARAM_NAME, L"" },
+  { MTPluginParam::TYPE_STRING, PROCESSING_MARGIN_PARAM_NAME, L"2" },
+  { MTPluginParam::TYPE_INT, USE_QUOTES_TIMEOUT_PARAM_NAME, L"0" },
 };
 
 // DLL entry point.
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Models of fake prices. A model gives the next offset (ticks) of a symbol
+// from the last real prices, from its previous offset and a random number,
+// and applies it to the last real bid/ask. Models are policy classes used
+// as template arguments of |FakePriceBatch::Generate|, so the inner loop
+// has no virtual calls nor per-symbol dispatch.
+enum PriceModel {
+  // Bid and ask move together (the spread is kept) by -2..2 ticks, never
+  // by the previous offset.
+  PRICE_JITTER,
+  // Random walk of one tick per fake rate around the last real prices,
+  // within +/-|kBound| ticks.
+  PRICE_WALK,
+  // Random walk of one tick per fake rate, more likely to step back towards
+  // the last real prices the further it is from them.
+  PRICE_REVERT,
+  // Bid stays at the last real bid, ask moves as |PRICE_JITTER| and never
+  // goes below bid. Needs a floating spread with room in the spread
+  // filter, see |QuoteLimits::AskCanMove|.
+  PRICE_FROZEN_BID,
+  PRICE_MODEL_NUM
+};
+
+namespace price_model {
+
+// Name of |model| in plugin parameters.
+inline const wchar_t* Name(PriceModel model) {
+  static const wchar_t* const kNames[PRICE_MODEL_NUM] =
+      { L"jitter", L"walk", L"revert", L"frozen_bid" };
+  return model >= 0 && model < PRICE_MODEL_NUM ? kNames[model] : L"";
+}
+
+// Model called |name|, return false if there is none.
+inline bool Parse(std::wstring_view name, PriceModel& model) {
+  for (int i = 0; i < PRICE_MODEL_NUM; i++) {
+    if (name == Name(static_cast<PriceModel>(i))) {
+      model = static_cast<PriceModel>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Largest jitter offset (ticks).
+const int32_t kMaxOffset = 2;
+
+// One of the 4 offsets in -2..2 other than |last|, from the 2 top bits of
+// |random|: drawn among 4 values and shifted past |last|.
+inline int32_t JitterOffset(int32_t last, uint64_t random) {
+  int32_t offset = static_cast<int32_t>(random >> 62) - kMaxOffset;
+  return offset + (offset >= last);
+}
+
+// -1 or 1 from the top bit of |random|.
+inline int32_t Step(uint64_t random) {
+  return static_cast<int32_t>(random >> 63) * 2 - 1;
+}
+
+struct Jitter {
+  static int32_t Next(int32_t last, uint64_t random) { return JitterOffset(last, random); }
+  static void Apply(double& bid, double& ask, double delta) {
+    bid += delta;
+    ask += delta;
+  }
+};
+
+struct Walk {
+  static const int32_t kBound = 10;
+  // Bounds reflect the walk, so it always moves.
+  static int32_t Next(int32_t last, uint64_t random) {
+    int32_t offset = std::min(std::max(last, -kBound), kBound) + Step(random);
+    offset = offset > kBound ? kBound - 1 : offset;
+    return offset < -kBound ? -kBound + 1 : offset;
+  }
+  static void Apply(double& bid, double& ask, double delta) {
+    bid += delta;
+    ask += delta;
+  }
+};
+
+struct Revert {
+  static const int32_t kBound = 10;
+  // Steps back towards 0 with probability (1 + |last| / kBound) / 2, from
+  // bits 32..47 of |random|: always at the bounds, as a fair walk at 0.
+  static int32_t Next(int32_t last, uint64_t random) {
+    last = std::min(std::max(last, -kBound), kBound);
+    int32_t sign = (last > 0) - (last < 0);
+    int64_t draw = static_cast<int64_t>((random >> 32) & 0xFFFF);
+    int32_t back = draw * 2 * kBound < 0x10000LL * (kBound + sign * last);
+    int32_t step = sign * (1 - 2 * back) + (sign == 0) * Step(random);
+    return last + step;
+  }
+  static void Apply(double& bid, double& ask, double delta) {
+    bid += delta;
+    ask += delta;
+  }
+};
+
+struct FrozenBid {
+  static int32_t Next(int32_t last, uint64_t random) { return JitterOffset(last, random); }
+  static void Apply(double& bid, double& ask, double delta) {
+    ask = std::max(ask + delta, bid);
+  }
+};
+
+}
+
+// Bounds of the quotes of a symbol, from its settings, which fake prices
+// are fitted into so that the server filters do not reject them: prices
+// on the tick size grid at the symbol digits, the fixed spread of the
+// symbol and its balance, or a floating spread within the spread filter.
+// Bounds are converted to ticks once, when symbol settings change.
+// Ex:
+//    QuoteLimits limits(symbol->Digits(), symbol->TickSize(), symbol->Spread(),
+//                       symbol->SpreadBalance(), symbol->FilterSpreadMin(),
+//                       symbol->FilterSpreadMax());
+//    limits.Fit(bid, ask);
+class QuoteLimits {
+public:
+  QuoteLimits() : digits_(0), point_(0), tick_(0), ticks_per_price_(0),
+                  fixed_spread_(0), balance_(0),
+                  min_ticks_(0), max_ticks_(0) {}
+
+  // Spreads and balance are in points, 0 is a floating spread or no
+  // filter bound. A zero tick size is one point.
+  QuoteLimits(UINT digits, double tick_size, UINT spread, INT spread_balance,
+              UINT filter_spread_min, UINT filter_spread_max) : QuoteLimits() {
+    digits_ = digits;
+    point_ = SMTMath::DecPow(-static_cast<int>(digits));
+    tick_ = tick_size > 0 ? tick_size : point_;
+    ticks_per_price_ = 1 / tick_;
+    fixed_spread_ = spread * point_;
+    balance_ = spread_balance * point_;
+    // Smallest and largest spread in whole ticks which pass the filter.
+    if (filter_spread_min != 0)
+      min_ticks_ = static_cast<INT64>(std::ceil(filter_spread_min * point_ / tick_ - kEpsilon));
+    if (filter_spread_max != 0)
+      max_ticks_ = std::max<INT64>(
+          0, static_cast<INT64>(std::floor(filter_spread_max * point_ / tick_ + kEpsilon)));
+  }
+
+  UINT Digits() const { return digits_; }
+  // Price of one point, 10^-digits.
+  double Point() const { return point_; }
+  double TickSize() const { return tick_; }
+
+  // Fit |bid| and |ask| into the limits. A fixed spread is laid around
+  // their middle, half of it on each side and the ask shifted up by the
+  // balance; a floating spread is clamped into the filter keeping the bid.
+  // Bid is snapped to the tick size, ask is set from it by the spread in
+  // whole ticks, both are normalized to the symbol digits.
+  void Fit(double& bid, double& ask) const {
+    if (tick_ <= 0)
+      return;
+    double spread = ask - bid;
+    if (fixed_spread_ > 0) {
+      double ask_shift = fixed_spread_ / 2 + balance_;
+      bid = (bid + ask) / 2 + ask_shift - fixed_spread_;
+      spread = fixed_spread_;
+    }
+    double snapped = static_cast<double>(std::llround(bid * ticks_per_price_)) * tick_;
+    bid = SMTMath::PriceNormalize(snapped, digits_);
+    ask = SMTMath::PriceNormalize(snapped + SpreadTicks(spread) * tick_, digits_);
+  }
+
+  // Fit |ask| into the limits keeping |bid| as it is, for prices whose bid
+  // must not move: the spread is clamped into the filter, or is the fixed
+  // one.
+  void FitAsk(double bid, double& ask) const {
+    if (tick_ <= 0)
+      return;
+    double spread = fixed_spread_ > 0 ? fixed_spread_ : ask - bid;
+    ask = SMTMath::PriceNormalize(bid + SpreadTicks(spread) * tick_, digits_);
+  }
+
+  // Ask fitted by |FitAsk| can take more than one value for a given bid:
+  // the spread is floating and the filter allows more than one spread.
+  bool AskCanMove() const {
+    return fixed_spread_ <= 0 && (max_ticks_ == 0 || max_ticks_ > min_ticks_);
+  }
+
+private:
+  // Tolerance of bounds which are whole multiples of the tick size.
+  static constexpr double kEpsilon = 1e-6;
+
+  // |spread| in whole ticks, clamped into the filter.
+  INT64 SpreadTicks(double spread) const {
+    INT64 ticks = std::max<INT64>(0, std::llround(spread * ticks_per_price_));
+    if (min_ticks_ != 0 && ticks < min_ticks_)
+      ticks = min_ticks_;
+    if (max_ticks_ != 0 && ticks > max_ticks_)
+      ticks = max_ticks_;
+    return ticks;
+  }
+
+  UINT digits_;
+  double point_;
+  double tick_;
+  double ticks_per_price_;
+  double fixed_spread_;
+  double balance_;
+  INT64 min_ticks_;
+  INT64 max_ticks_;
+};
+
+// Fake prices of the symbols of one model due in one generator pass,
+// computed at once. Inputs are kept as structure of arrays and each symbol
+// draws from its own counter-based random stream (SplitMix64: the draw is
+// a hash of the stream key and the symbol counter), so |Generate| is a
+// branch-free loop without dependencies between symbols which compilers
+// vectorize, and there is no shared engine state.
+// Ex:
+//    FakePriceBatch prices;
+//    prices.Add(bid, ask, tick_size, info.last_rand, info.rand_stream, info.rand_counter);
+//    prices.Generate<price_model::Walk>();
+//    tick.bid = prices.bid[0]; info.last_rand = prices.last_offset[0]; ...
+class FakePriceBatch {
+public:
+  // Last prices on input, fake prices on output. Arrays are kept at their
+  // capacity, only the first |Size()| entries are used.
+  std::vector<double> bid;
+  std::vector<double> ask;
+  // Price of one offset step, the tick size of the symbol: offsets in
+  // whole ticks keep prices on its grid, so fitting them into the quote
+  // limits does not round an offset back to the previous one.
+  std::vector<double> tick;
+  // Previous offset of the symbol on input, new one on output.
+  std::vector<int32_t> last_offset;
+  // Random stream of the symbol and its position, advanced by one draw.
+  std::vector<uint64_t> stream;
+  std::vector<uint64_t> counter;
+
+  FakePriceBatch() : size_(0) {}
+
+  size_t Size() const { return size_; }
+  void Clear() { size_ = 0; }
+
+  void Reserve(size_t count) {
+    if (count <= bid.size())
+      return;
+    bid.resize(count);
+    ask.resize(count);
+    tick.resize(count);
+    last_offset.resize(count);
+    stream.resize(count);
+    counter.resize(count);
+  }
+
+  // Add a symbol, return its position.
+  size_t Add(double last_bid, double last_ask, double tick_size,
+             int32_t offset, uint64_t symbol_stream, uint64_t symbol_counter) {
+    if (size_ == bid.size())
+      Reserve(size_ < 64 ? 64 : 2 * size_);
+    size_t i = size_++;
+    bid[i] = last_bid;
+    ask[i] = last_ask;
+    tick[i] = tick_size;
+    last_offset[i] = offset;
+    stream[i] = symbol_stream;
+    counter[i] = symbol_counter;
+    return i;
+  }
+
+  // Move prices of all symbols with model |ModelT|.
+  template<typename ModelT>
+  void Generate() {
+    size_t count = Size();
+    double* bids = bid.data();
+    double* asks = ask.data();
+    const double* ticks = tick.data();
+    int32_t* offsets = last_offset.data();
+    const uint64_t* streams = stream.data();
+    uint64_t* counters = counter.data();
+    for (size_t i = 0; i < count; i++) {
+      int32_t offset = ModelT::Next(offsets[i], Random(streams[i], counters[i]));
+      counters[i]++;
+      offsets[i] = offset;
+      ModelT::Apply(bids[i], asks[i], offset * ticks[i]);
+    }
+  }
+
+  // Move prices of all symbols with |model|, dispatched once per batch.
+  void Generate(PriceModel model) {
+    switch (model) {
+      case PRICE_WALK: Generate<price_model::Walk>(); break;
+      case PRICE_REVERT: Generate<price_model::Revert>(); break;
+      case PRICE_FROZEN_BID: Generate<price_model::FrozenBid>(); break;
+      default: Generate<price_model::Jitter>(); break;
+    }
+  }
+
+  // Draw number |counter| of stream |stream|.
+  static uint64_t Random(uint64_t stream, uint64_t counter) {
+    uint64_t z = stream + (counter + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+private:
+  size_t size_;
+};
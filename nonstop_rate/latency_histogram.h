@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#ifdef _WIN32
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LATENCY_HISTOGRAM_TSC
+#endif
+
+// Histogram of latencies with logarithmic buckets, as HDR histograms:
+// values below 2^kSubBits have a bucket each, every power of two above is
+// split into 2^kSubBits buckets, so a value is known within 1/2^kSubBits
+// (6%) of itself up to |kMaxValue|. Larger values go to the last bucket.
+// Values are in units of |Now|, the time stamp counter on x86, which is
+// cheaper to read than steady_clock; snapshots convert them to
+// nanoseconds with the counter rate measured against steady_clock.
+// The first |kShards| recording threads each own a shard in its own cache
+// lines, written with plain loads and stores as |TickAddCounters|, so hooks
+// of different threads neither contend nor use locked instructions.
+// Further threads share one more shard with atomic additions. Readers
+// merge the shards into a |Snapshot|, without locking; counts recorded
+// meanwhile may be seen or not.
+// Ex:
+//    LatencyHistogram histogram;
+//    { LatencyHistogram::Timer timer(histogram); ... }  // Any thread.
+//    LatencyHistogram::Snapshot snapshot;
+//    histogram.Read(snapshot);
+//    snapshot.Percentile(99.0) ...
+class LatencyHistogram {
+public:
+  static const int kSubBits = 4;
+  static const int kMaxBits = 40;
+  // About 6 minutes of a 3GHz counter.
+  static const uint64_t kMaxValue = (uint64_t(1) << kMaxBits) - 1;
+  static const size_t kBuckets = (kMaxBits - kSubBits + 1) << kSubBits;
+
+  // Merged counts of all shards. Results are in nanoseconds.
+  struct Snapshot {
+    // Counts per bucket, of values in |Now| units.
+    std::vector<uint64_t> counts;
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    // Nanoseconds per |Now| unit when the snapshot was taken.
+    double ns_per_unit = 1;
+
+    // Remove counts of |earlier|, a previous snapshot of the same
+    // histogram, to get the values recorded since.
+    void Subtract(const Snapshot& earlier) {
+      for (size_t i = 0; i < counts.size() && i < earlier.counts.size(); i++)
+        counts[i] -= std::min(counts[i], earlier.counts[i]);
+      count -= std::min(count, earlier.count);
+      sum -= std::min(sum, earlier.sum);
+    }
+
+    // Smallest value which |percentile| percents of values do not exceed,
+    // as the highest value of its bucket. 0 if there is no value.
+    uint64_t Percentile(double percentile) const {
+      uint64_t total = 0;
+      for (uint64_t bucket : counts)
+        total += bucket;
+      if (total == 0)
+        return 0;
+      double rank = std::max(1.0, std::min(percentile, 100.0) * total / 100.0);
+      uint64_t seen = 0;
+      for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= rank)
+          return Ns(BucketHigh(i));
+      }
+      return Ns(BucketHigh(counts.size() - 1));
+    }
+
+    uint64_t Max() const {
+      for (size_t i = counts.size(); i-- > 0;) {
+        if (counts[i] != 0)
+          return Ns(BucketHigh(i));
+      }
+      return 0;
+    }
+
+    uint64_t Mean() const { return count ? Ns(sum / count) : 0; }
+
+    uint64_t Ns(uint64_t value) const {
+      return static_cast<uint64_t>(value * ns_per_unit + 0.5);
+    }
+  };
+
+  // Record the time from its construction to its destruction.
+  class Timer {
+  public:
+    explicit Timer(LatencyHistogram& histogram) : histogram_(histogram), start_(Now()) {}
+    ~Timer() { histogram_.Record(Now() - start_); }
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+  private:
+    LatencyHistogram& histogram_;
+    uint64_t start_;
+  };
+
+  LatencyHistogram() : shards_(new Shard[kShards + 1]) {
+    // The counter rate is measured from the first histogram.
+    NsPerUnit();
+  }
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  // Current time in histogram units.
+  static uint64_t Now() {
+#ifdef LATENCY_HISTOGRAM_TSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+  }
+
+  // Record |value|, a difference of |Now| values. Counters which went
+  // backwards are recorded as 0.
+  void Record(uint64_t value) {
+    if (static_cast<int64_t>(value) < 0)
+      value = 0;
+    size_t index = ThreadShard();
+    Shard& shard = shards_[index];
+    std::atomic<uint64_t>& count = shard.counts[Bucket(value)];
+    if (index < kShards) {
+      count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      shard.sum.store(shard.sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    } else {
+      count.fetch_add(1, std::memory_order_relaxed);
+      shard.sum.fetch_add(value, std::memory_order_relaxed);
+    }
+  }
+
+  // Merge all shards into |snapshot|.
+  void Read(Snapshot& snapshot) const {
+    snapshot.counts.assign(kBuckets, 0);
+    snapshot.count = 0;
+    snapshot.sum = 0;
+    snapshot.ns_per_unit = NsPerUnit();
+    for (size_t s = 0; s <= kShards; s++) {
+      const Shard& shard = shards_[s];
+      for (size_t i = 0; i < kBuckets; i++) {
+        uint64_t count = shard.counts[i].load(std::memory_order_relaxed);
+        snapshot.counts[i] += count;
+        snapshot.count += count;
+      }
+      snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+    }
+  }
+
+  // Bucket of |value| and the highest value it holds.
+  static size_t Bucket(uint64_t value) {
+    if (value > kMaxValue)
+      value = kMaxValue;
+    if (value < (uint64_t(1) << kSubBits))
+      return static_cast<size_t>(value);
+    int exponent = HighestBit(value);
+    size_t sub = static_cast<size_t>(value >> (exponent - kSubBits)) & ((size_t(1) << kSubBits) - 1);
+    return (static_cast<size_t>(exponent - kSubBits + 1) << kSubBits) + sub;
+  }
+  static uint64_t BucketHigh(size_t bucket) {
+    if (bucket < (size_t(1) << kSubBits))
+      return bucket;
+    int exponent = static_cast<int>(bucket >> kSubBits) + kSubBits - 1;
+    uint64_t sub = bucket & ((size_t(1) << kSubBits) - 1);
+    uint64_t low = ((uint64_t(1) << kSubBits) + sub) << (exponent - kSubBits);
+    return low + (uint64_t(1) << (exponent - kSubBits)) - 1;
+  }
+
+private:
+  // Shards owned by one recording thread each. Threads take them in turn
+  // and keep them, shard |kShards| is shared by the threads after them.
+  static const size_t kShards = 32;
+
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> counts[kBuckets] = {};
+    std::atomic<uint64_t> sum{ 0 };
+  };
+
+  static size_t ThreadShard() {
+    static std::atomic<size_t> next_shard(0);
+    static thread_local size_t shard = [] {
+      size_t next = next_shard.fetch_add(1);
+      return next < kShards ? next : kShards;
+    }();
+    return shard;
+  }
+
+  // Nanoseconds per |Now| unit: steady_clock time over counter ticks since
+  // the first call, more precise as the process runs.
+  static double NsPerUnit() {
+#ifdef LATENCY_HISTOGRAM_TSC
+    using std::chrono::steady_clock;
+    static const steady_clock::time_point start_time = steady_clock::now();
+    static const uint64_t start_counter = Now();
+    double ns = std::chrono::duration<double, std::nano>(steady_clock::now() - start_time).count();
+    uint64_t units = Now() - start_counter;
+    return ns > 0 && units > 0 ? ns / units : 1;
+#else
+    return 1;
+#endif
+  }
+
+  // Position of the highest bit set of non-zero |value|.
+  static int HighestBit(uint64_t value) {
+#if defined(_WIN64)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#elif defined(_WIN32)
+    // No 64-bit scan on x86, the high half is scanned first.
+    unsigned long index;
+    if (_BitScanReverse(&index, static_cast<unsigned long>(value >> 32)))
+      return static_cast<int>(index) + 32;
+    _BitScanReverse(&index, static_cast<unsigned long>(value));
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+  }
+
+  std::unique_ptr<Shard[]> shards_;
+};
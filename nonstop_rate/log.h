@@ -1,31 +1,75 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <ctime>
+#ifndef _WIN32
+#include <filesystem>
+#endif
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <locale>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <tchar.h>
 
+#include "mpsc_ring.h"
+#include "timestamp_cache.h"
+
 enum Severity {
-  INFO = 0,
-  WARNING = 1,
-  ERR = 2,
-  FATAL = 3,
+  DEBUG = 0,
+  INFO = 1,
+  WARNING = 2,
+  ERR = 3,
+  FATAL = 4,
   SERVERITY_NUM
 };
 
+// Lowest severity compiled in. Records below it are removed at compile time,
+// with the formatting of their arguments. Development builds keep DEBUG.
+#ifndef LOG_MIN_SEVERITY
+#ifdef _DEV
+#define LOG_MIN_SEVERITY DEBUG
+#else
+#define LOG_MIN_SEVERITY INFO
+#endif
+#endif
+
+// Log a record built with stream operators. Arguments are only formatted
+// if |severity| is compiled in and enabled by LogEngine::SetLevel.
+// Ex:
+//    JOURNAL(DEBUG, "HookTick(). Tick is not from feeder, index=" << feeder);
+#define JOURNAL(severity, stream)                                  \
+  do {                                                             \
+    if ((severity) >= LOG_MIN_SEVERITY &&                          \
+        LogEngine::IsEnabled(severity)) {                          \
+      LogEngine::StreamT journal_stream;                           \
+      journal_stream << stream;                                    \
+      LogEngine::Journal(severity, journal_stream.str());          \
+    }                                                              \
+  } while (0)
+
 // This class used to write log to file.
 // We can improve it by adding some kind of logs,
 // ex: write log to file, standard output, server log, etc.
 // Can use for both std::string and std::wstring.
 // But please remember to set |Character Set| property to Unicode or Multi-byte.
+//
+// |Journal| only formats the record and puts it into a lock-free ring
+// buffer, a background thread drains the buffer, keeps the log file open,
+// writes records in batches and switches to a new file every day.
+// Hooks never wait for the disk: when the buffer is full, records are
+// dropped (or the caller waits, see |SetOverflowPolicy|) and counted.
 // Ex:
 //    void foo() {
 //      LogEngine::Jounal(INFO, "Hello world!");
 //    }
+//    LogEngine::Shutdown();  // On plugin stop, write everything and stop.
 template<typename CharT>
 //#ifdef _UNICODE
 //         typename = typename std::enable_if<std::is_same<CharT, wchar_t>::value, CharT>::type>
@@ -35,77 +79,337 @@ template<typename CharT>
 class Log {
 public:
   using StringT = std::basic_string<CharT>;
+  using StreamT = std::basic_ostringstream<CharT>;
 
   static const StringT log_lv[];
   static const StringT kPluginName;
   static const StringT kLogFileExtension;
 
+  // What |Journal| does when the buffer is full.
+  enum OverflowPolicy {
+    // Drop the record, the caller never waits.
+    DROP_RECORD = 0,
+    // Wait until the writer thread makes room.
+    WAIT_FOR_ROOM = 1
+  };
+
+  // Counters since the plugin is loaded.
+  struct Stats {
+    // Records written to file.
+    uint64_t written;
+    // Records dropped because the buffer was full.
+    uint64_t dropped;
+    // Records which waited because the buffer was full.
+    uint64_t blocked;
+  };
+
   // Constructor/ destructor.
   Log() = default;
   virtual ~Log() = default;
 
   // Log message with serverity.
   static void Journal(Severity serverity, const StringT& message) {
-    std::lock_guard<std::mutex> lock(io_mutex_);
-
-    // File handler.
-    std::basic_ofstream<CharT> file(GetLogFilePath(), std::ios::app);
-    if (!file)
+    if (!IsEnabled(serverity))
       return;
-    // Write log to file as the following format:
-    //    "YYYY/mm/dd HH:MM:SS: [serverity]Content of log".
-    file << GetCurrentDateTime() << _T(": ")
-         << _T("[") << log_lv[serverity] << _T("] ")
-         << message << std::endl;
-    file.close();
+    Engine& engine = GetEngine();
+    engine.Start();
+
+    // Record is formatted as the following format:
+    //    "YYYY-mm-dd HH:MM:SS.mmm: [serverity] Content of log".
+    auto now = std::chrono::system_clock::now();
+    CharT prefix[kPrefixChars];
+    size_t prefix_length = TimestampCache<CharT>::Format(now, prefix);
+    const CharT separator[] = _T(": [");
+    const StringT& level = log_lv[serverity];
+    prefix_length = std::copy(separator, separator + 3, prefix + prefix_length) - prefix;
+    prefix_length = std::copy(level.begin(), level.end(), prefix + prefix_length) - prefix;
+    prefix[prefix_length++] = CharT(']');
+    prefix[prefix_length++] = CharT(' ');
+
+    // Long messages span several consecutive cells, very long ones are cut.
+    size_t length = std::min(prefix_length + message.size(), kMaxRecordCells * kCellChars);
+    size_t cells = (length + kCellChars - 1) / kCellChars;
+    size_t pos;
+    if (!engine.ring.TryReserve(cells, pos)) {
+      if (engine.overflow_policy.load(std::memory_order_relaxed) == DROP_RECORD) {
+        engine.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      engine.blocked.fetch_add(1, std::memory_order_relaxed);
+      while (!engine.ring.TryReserve(cells, pos))
+        std::this_thread::yield();
+    }
+
+    size_t copied = 0;
+    for (size_t i = 0; i < cells; i++) {
+      Cell& cell = engine.ring.At(pos + i);
+      cell.time = std::chrono::system_clock::to_time_t(now);
+      cell.length = static_cast<uint16_t>(std::min(kCellChars, length - copied));
+      cell.last = i + 1 == cells;
+      for (size_t c = 0; c < cell.length; c++, copied++)
+        cell.text[c] = copied < prefix_length ? prefix[copied] : message[copied - prefix_length];
+    }
+    // Commit in order, the writer stops at the first uncommitted cell.
+    for (size_t i = 0; i < cells; i++)
+      engine.ring.Commit(pos + i);
+    engine.Wake();
+  }
+
+  // Records below |level| are skipped at run time.
+  static void SetLevel(Severity level) {
+    GetEngine().level.store(level, std::memory_order_relaxed);
+  }
+
+  static bool IsEnabled(Severity serverity) {
+    return serverity >= GetEngine().level.load(std::memory_order_relaxed);
+  }
+
+  // Parse severity name as written in records ("DEBUG", "INFO", ...),
+  // case insensitive. Return false if |name| is unknown.
+  static bool ParseSeverity(const StringT& name, Severity& serverity) {
+    return ParseSeverity(name.data(), name.size(), serverity);
+  }
+  // Same for |length| characters at |name|, which need not be terminated.
+  static bool ParseSeverity(const CharT* name, size_t length, Severity& serverity) {
+    for (int i = 0; i < SERVERITY_NUM; i++) {
+      const StringT& level = log_lv[i];
+      if (level.size() == length &&
+          std::equal(level.begin(), level.end(), name, [](CharT a, CharT b) {
+            return std::toupper(a, std::locale::classic()) == std::toupper(b, std::locale::classic());
+          })) {
+        serverity = static_cast<Severity>(i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Select what |Journal| does when the buffer is full.
+  static void SetOverflowPolicy(OverflowPolicy policy) {
+    GetEngine().overflow_policy = policy;
+  }
+
+  static Stats GetStats() {
+    Engine& engine = GetEngine();
+    Stats stats;
+    stats.written = engine.written.load(std::memory_order_relaxed);
+    stats.dropped = engine.dropped.load(std::memory_order_relaxed);
+    stats.blocked = engine.blocked.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  // Write all buffered records, then stop the writer thread and close the
+  // file. A later |Journal| starts them again.
+  // Must not be called from DllMain, the writer thread cannot be joined there.
+  static void Shutdown() {
+    GetEngine().Stop();
   }
 
 private:
-  // Return path of log file.
-  static StringT GetLogFilePath() {
+  // Characters per ring buffer cell.
+  static constexpr size_t kCellChars = 240;
+  // Ring buffer cells, messages longer than that are cut.
+  static constexpr size_t kRingCells = 4096;
+  static constexpr size_t kMaxRecordCells = 64;
+  // Characters written to file at once.
+  static constexpr size_t kBatchChars = 64 * 1024;
+  // Room for time and severity of a record.
+  static constexpr size_t kPrefixChars = 40;
+
+  struct Cell {
+    std::time_t time;
+    uint16_t length;
+    // Last cell of a record.
+    bool last;
+    CharT text[kCellChars];
+  };
+
+  struct Engine {
+    Engine() : running(false), stop(false), level(LOG_MIN_SEVERITY), overflow_policy(DROP_RECORD),
+               written(0), dropped(0), blocked(0), idle(false), next_rotation_time(0) {}
+
+    void Start() {
+      if (running.load(std::memory_order_acquire))
+        return;
+      std::lock_guard<std::mutex> lock(control_mutex);
+      if (running.load(std::memory_order_relaxed))
+        return;
+      stop = false;
+      writer = std::thread(&Engine::Run, this);
+      running.store(true, std::memory_order_release);
+    }
+
+    void Stop() {
+      std::lock_guard<std::mutex> lock(control_mutex);
+      if (!running.load(std::memory_order_relaxed))
+        return;
+      stop = true;
+      Wake();
+      writer.join();
+      running.store(false, std::memory_order_release);
+    }
+
+    // Wake the writer thread if it waits for records. Producers only take
+    // |wake_mutex| when the writer is idle, i.e. the buffer was empty.
+    void Wake() {
+      // Pairs with the fence in |WaitForRecords|: either the writer sees the
+      // new record or |stop|, or we see it idle.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!idle.load(std::memory_order_relaxed))
+        return;
+      {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        idle.store(false, std::memory_order_relaxed);
+      }
+      wake_cv.notify_one();
+    }
+
+    // Block the writer thread until a record is committed or |stop| is set.
+    void WaitForRecords() {
+      idle.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!ring.Front() && !stop.load(std::memory_order_relaxed)) {
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        wake_cv.wait(lock, [this] { return !idle.load(std::memory_order_relaxed); });
+      }
+      idle.store(false, std::memory_order_relaxed);
+    }
+
+    // Writer thread.
+    void Run() {
+      StringT batch;
+      batch.reserve(kBatchChars + kCellChars + 1);
+      for (;;) {
+        bool stopping = stop.load(std::memory_order_acquire);
+        uint64_t records = 0;
+        while (batch.size() < kBatchChars) {
+          Cell* cell = ring.Front();
+          if (!cell)
+            break;
+          // Records of the next day go to the next file.
+          if (cell->time >= next_rotation_time && !batch.empty())
+            break;
+          if (cell->time >= next_rotation_time)
+            Rotate(cell->time);
+          batch.append(cell->text, cell->length);
+          if (cell->last) {
+            batch.push_back(CharT('\n'));
+            records++;
+          }
+          ring.Pop();
+        }
+
+        if (!batch.empty()) {
+          if (file) {
+            file.write(batch.data(), batch.size());
+            file.flush();
+          }
+          batch.clear();
+          written.fetch_add(records, std::memory_order_relaxed);
+          continue;
+        }
+        // Records committed before |stop| was set are written.
+        if (stopping)
+          break;
+        WaitForRecords();
+      }
+      file.close();
+      next_rotation_time = 0;
+    }
+
+    // Open log file of the day of |time|.
+    void Rotate(std::time_t time) {
+      if (file.is_open())
+        file.close();
+
+      std::tm tm_time = LocalTime(time);
+      tm_time.tm_hour = 0;
+      tm_time.tm_min = 0;
+      tm_time.tm_sec = 0;
+      tm_time.tm_mday++;
+      tm_time.tm_isdst = -1;
+      next_rotation_time = std::mktime(&tm_time);
+
+      StringT log_file_path = GetLogFilePath(GetDate(time));
+#ifdef _WIN32
+      file.open(log_file_path, std::ios::app | std::ios::binary);
+#else
+      // Linux host build: the path is built with Windows separators and
+      // libstdc++ only opens narrow or filesystem paths.
+      std::replace(log_file_path.begin(), log_file_path.end(), CharT('\\'), CharT('/'));
+      std::filesystem::path path = std::filesystem::path(log_file_path).lexically_normal();
+      std::error_code error;
+      std::filesystem::create_directories(path.parent_path(), error);
+      file.open(path, std::ios::app | std::ios::binary);
+#endif
+    }
+
+    MpscRing<Cell, kRingCells> ring;
+
+    std::atomic<bool> running;
+    std::atomic<bool> stop;
+    std::atomic<int> level;
+    std::atomic<int> overflow_policy;
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> blocked;
+
+    // Set by the writer thread while it waits on |wake_cv|.
+    std::atomic<bool> idle;
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;
+
+    // Writer thread state.
+    std::thread writer;
+    std::basic_ofstream<CharT> file;
+    std::time_t next_rotation_time;
+
+    // Serialize writer thread start/stop.
+    std::mutex control_mutex;
+  };
+
+  // The engine is never destroyed: joining the writer thread from static
+  // destruction deadlocks under the loader lock on DLL unload. |Shutdown|
+  // is the only place which joins it; otherwise the thread ends with the
+  // process.
+  static Engine& GetEngine() {
+    static Engine* engine = new Engine;
+    return *engine;
+  }
+
+  // Return path of log file for |date|.
+  static StringT GetLogFilePath(const StringT& date) {
     CharT path[256];
-    GetModuleFileName(NULL, path, sizeof(path) - 1);
+    GetModuleFileName(NULL, path, _countof(path) - 1);
     StringT program_path(path);
 
     StringT log_file_path = program_path + _T("\\..\\logs\\");
-    return log_file_path + kPluginName + _T(".") + GetCurrentDate() + kLogFileExtension;
+    return log_file_path + kPluginName + _T(".") + date + kLogFileExtension;
   }
 
-  // Get time as a string.
-  // Format of GetCurrentDate() is "%Y%m%d".
-  // Format of GetCurrentDateTime() is "%Y/%m/%d %H:%M%S".
-  static StringT GetCurrentDate() {
-    using std::chrono::system_clock;
-    std::time_t now = system_clock::to_time_t(system_clock::now());
-
-    struct std::tm * ptm = std::localtime(&now);
-    const CharT format[] = _T("%Y%m%d");
-    std::basic_stringstream<CharT> sstream;
-    sstream << std::put_time(ptm, format);
-    return sstream.str();
+  static std::tm LocalTime(std::time_t time) {
+    std::tm tm_time;
+#ifdef _WIN32
+    localtime_s(&tm_time, &time);
+#else
+    localtime_r(&time, &tm_time);
+#endif
+    return tm_time;
   }
 
-  static StringT GetCurrentDateTime() {
-    using std::chrono::system_clock;
-    std::time_t now = system_clock::to_time_t(system_clock::now());
-
-    struct std::tm * ptm = std::localtime(&now);
-    const CharT format[] = _T("%F %T");
+  // Get date as a string, format is "%Y%m%d".
+  static StringT GetDate(std::time_t time) {
+    std::tm tm_time = LocalTime(time);
+    const CharT format[] = _T("%Y%m%d");
     std::basic_stringstream<CharT> sstream;
-    sstream << std::put_time(ptm, format);
+    sstream << std::put_time(&tm_time, format);
     return sstream.str();
   }
-
-  // File handling synchronization.
-  static std::mutex io_mutex_;
 };
 
-template<typename CharT>
-std::mutex Log<CharT>::io_mutex_;
-
 template<typename CharT>
 const std::basic_string<CharT> Log<CharT>::log_lv[SERVERITY_NUM] =
-    { _T("INFO"), _T("WARNING"), _T("ERROR"), _T("FATAL") };
+    { _T("DEBUG"), _T("INFO"), _T("WARNING"), _T("ERROR"), _T("FATAL") };
 
 template<typename CharT>
 const std::basic_string<CharT> Log<CharT>::kPluginName = _T("NonstopRate");
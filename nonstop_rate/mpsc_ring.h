@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue with many producers and a single consumer.
+// Every cell carries a sequence number telling whether it is free for the
+// current lap, written or already consumed, so producers only compete on
+// the head index and never wait for each other.
+// A producer may reserve several consecutive cells at once, they are
+// consumed in order, which keeps multi-cell items contiguous.
+// Ex:
+//    MpscRing<Record, 1024> ring;
+//    size_t pos;
+//    if (ring.TryReserve(1, pos)) {       // Producer.
+//      ring.At(pos) = record;
+//      ring.Commit(pos);
+//    }
+//    while (Record* record = ring.Front()) {  // Consumer.
+//      Write(*record);
+//      ring.Pop();
+//    }
+template<typename T, size_t kCapacity>
+class MpscRing {
+  static_assert(kCapacity >= 2 && (kCapacity & (kCapacity - 1)) == 0,
+                "MpscRing capacity must be a power of 2");
+public:
+  MpscRing() : head_(0), tail_(0) {
+    for (size_t i = 0; i < kCapacity; i++)
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  MpscRing(const MpscRing&) = delete;
+  MpscRing& operator=(const MpscRing&) = delete;
+
+  static size_t Capacity() { return kCapacity; }
+
+  // Reserve |count| consecutive cells starting at |pos|. Return false
+  // if there is not enough free room, nothing is reserved in that case.
+  // Every reserved cell must be filled and committed.
+  bool TryReserve(size_t count, size_t& pos) {
+    if (count == 0 || count > kCapacity)
+      return false;
+    pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      // Cells are freed in order, if the last cell is free for this lap,
+      // so are the cells before it.
+      size_t first = Cell(pos).sequence.load(std::memory_order_acquire);
+      size_t last = Cell(pos + count - 1).sequence.load(std::memory_order_acquire);
+      if (first == pos && last == pos + count - 1) {
+        if (head_.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+          return true;
+      } else if (static_cast<ptrdiff_t>(last - (pos + count - 1)) < 0) {
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Cell reserved at |pos|.
+  T& At(size_t pos) { return Cell(pos).value; }
+
+  // Make cell at |pos| visible to the consumer.
+  void Commit(size_t pos) {
+    Cell(pos).sequence.store(pos + 1, std::memory_order_release);
+  }
+
+  // Consumer side: oldest committed cell, or nullptr if the oldest cell is
+  // empty or still being written.
+  T* Front() {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    CellT& cell = Cell(tail);
+    if (cell.sequence.load(std::memory_order_acquire) != tail + 1)
+      return nullptr;
+    return &cell.value;
+  }
+
+  // Consumer side: free the cell returned by |Front|.
+  void Pop() {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    Cell(tail).sequence.store(tail + kCapacity, std::memory_order_release);
+    tail_.store(tail + 1, std::memory_order_relaxed);
+  }
+
+  // Approximate number of reserved cells, for statistics only.
+  size_t Size() const {
+    return head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct CellT {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  CellT& Cell(size_t pos) { return cells_[pos & (kCapacity - 1)]; }
+
+  CellT cells_[kCapacity];
+  // Next position to reserve, shared by producers.
+  alignas(64) std::atomic<size_t> head_;
+  // Next position to consume, only changed by the consumer.
+  alignas(64) std::atomic<size_t> tail_;
+};
@@ -1,18 +1,39 @@
 #include "stdafx.h"
 #include "nonstop_rate_plugin.h"
 
-#include <regex>
+#include <iomanip>
 #include <sstream>
 
 #include "common.h"
+#include "param_tokenizer.h"
 
 namespace {
 
-// Interval time for an 'AddRate' action (milliseconds).
-const int kAddRateIntervalTime = 500;
+// Resolution of fake rate deadlines (milliseconds). The AddRate thread
+// sleeps until the next due symbol and only handles due symbols.
+const int kTimerResolution = 5;
 
-// Default time out value (seconds).
-const int kDefaultTimeout = 30;
+// Default time out value (milliseconds).
+const INT64 kDefaultTimeout = 30000;
+// Default time taken to process fake rates, subtracted from timeouts so
+// that they are added in time (milliseconds).
+const INT64 kDefaultProcessingMargin = 2000;
+
+// Default maximum age of rates seeded from snapshot or last ticks
+// (milliseconds).
+const INT64 kDefaultSnapshotMaxAge = 300000;
+// Symbols the snapshot file has room for when it is created.
+const UINT kSnapshotCapacity = 16384;
+
+// Period of fake rates results and latency summaries in the journal
+// (milliseconds), and the number of most rejected symbols they list.
+const INT64 kStatsPeriod = 60000;
+const size_t kTickStatsTopSymbols = 5;
+
+// Last ticks are read by up to |kSeedThreads| threads, |kSeedChunk|
+// symbols at a time.
+const size_t kSeedThreads = 4;
+const size_t kSeedChunk = 256;
 
 // Additional data, which used to marked a tick is fake.
 const unsigned int kFakeRateReservedBytes[] = { 0x46, 0x41, 0x4B, 0x45 }; // FAKE
@@ -21,9 +42,42 @@ bool IsFake(const unsigned int data[]) {
   return std::equal(data, data + 4, kFakeRateReservedBytes);
 }
 
+// Timeout the AddRate thread waits for, from |timeout| in parameters.
+// Suppose process time is |margin|, subtract it from real timeout. Fake
+// rates are also added up to one timer resolution late.
+INT64 FakeRateTimeout(INT64 timeout, INT64 margin) {
+  margin = std::max<INT64>(margin, kTimerResolution);
+  return timeout > margin ? timeout - margin : timeout;
+}
+
+// Monotonic clock in milliseconds, not affected by system time changes.
+INT64 MonotonicMsc() {
+  using namespace std::chrono;
+  return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Path of the rates snapshot file, in "bases" of the server directory.
+std::wstring SnapshotFilePath() {
+  wchar_t path[MAX_PATH] = { 0 };
+  GetModuleFileName(NULL, path, _countof(path) - 1);
+  return std::wstring(path) + L"\\..\\bases\\NonstopRate.snapshot";
+}
+
+// Time of |tick| (|MTTick| or |MTTickShort|) in milliseconds. Sources which
+// only fill |datetime| are handled as if the rate came at the beginning of
+// that second.
+template<typename TickT>
+INT64 TickTimeMsc(const TickT& tick) {
+  return tick.datetime_msc != 0 ? tick.datetime_msc : tick.datetime * 1000LL;
 }
 
-NonstopRatePlugin::NonstopRatePlugin(void) {
+}
+
+NonstopRatePlugin::NonstopRatePlugin(void)
+    : schedules_version_(0), stop_thread_(false), wake_(false) {
+  for (auto& bits : main_feeders_)
+    bits = 0;
+
   // Initialize random number engine.
   std::random_device rd;
   number_engine_.seed(rd());
@@ -48,13 +102,35 @@ MTAPIRES NonstopRatePlugin::Start(IMTServerAPI* server) {
   if ((plugin_config_ = server_->PluginCreate()) == nullptr ||
       (feeder_config_ = server_->FeederCreate()) == nullptr ||
       (symbol_config_ = server_->SymbolCreate()) == nullptr ||
-      (server_config_ = server_->NetServerCreate()) == nullptr) {
+      (server_config_ = server_->NetServerCreate()) == nullptr ||
+      (session_config_ = server_->SymbolSessionCreate()) == nullptr ||
+      (holiday_config_ = server_->HolidayCreate()) == nullptr) {
     LogEngine::Journal(ERR, L"Creating config objects failed!");
     return MT_RET_ERR_MEM;
   }
 
+  // Holidays are needed to build quote schedules of watched symbols.
+  {
+    std::lock_guard<std::mutex> lock(sync_mutex_);
+    LoadHolidays();
+  }
+
+  // Rates of the previous run are restored while symbols are resolved.
+  OpenSnapshot();
+
   // Read plugin parameters.
   ReadPluginParameters();
+  if (auto config = config_.Read()) {
+    size_t restored = 0, seeded = 0;
+    for (auto& symbol : config->symbols) {
+      RateState state = symbol.value.info->state.Load();
+      restored += state.has_real_rate && state.source == RATE_SNAPSHOT;
+      seeded += state.has_real_rate && state.source == RATE_TICK_LAST;
+    }
+    JOURNAL(INFO, "Start(): " << config->symbols.Size() << " symbols, rates of "
+                  << restored << " restored from snapshot, " << seeded
+                  << " seeded from last ticks.");
+  }
 
   // Read |feeder_switch_timeout_| from server configuration.
   ReadServerParameters();
@@ -63,7 +139,10 @@ MTAPIRES NonstopRatePlugin::Start(IMTServerAPI* server) {
   MTAPIRES result = MT_RET_OK;
   if ((result = server_->PluginSubscribe(this)) != MT_RET_OK ||
       (result = server_->TickSubscribe(this)) != MT_RET_OK ||
-      (result = server_->NetServerSubscribe(this)) != MT_RET_OK) {
+      (result = server_->NetServerSubscribe(this)) != MT_RET_OK ||
+      (result = server_->FeederSubscribe(this)) != MT_RET_OK ||
+      (result = server_->SymbolSubscribe(this)) != MT_RET_OK ||
+      (result = server_->HolidaySubscribe(this)) != MT_RET_OK) {
     LogEngine::Journal(ERR, L"Subscribing hooks and events failed!");
     return result;
   }
@@ -84,21 +163,33 @@ MTAPIRES NonstopRatePlugin::Stop(void) {
     server_->PluginUnsubscribe(this);
     server_->TickUnsubscribe(this);
     server_->NetServerUnsubscribe(this);
+    server_->FeederUnsubscribe(this);
+    server_->SymbolUnsubscribe(this);
+    server_->HolidayUnsubscribe(this);
   }
 
   // Clear member variables.
-  timeout_ = kDefaultTimeout;
-  feeder_name_ = L"";
-  symbols_.clear();
+  for (auto& bits : main_feeders_)
+    bits = 0;
+  config_.Publish(nullptr);
+  // No hook uses the symbols of the snapshot anymore.
+  snapshot_.Close();
+  holidays_.clear();
+  schedules_.clear();
 
   // Delete interface.
   if (plugin_config_) { plugin_config_->Release(); plugin_config_ = nullptr; }
   if (feeder_config_) { feeder_config_->Release(); feeder_config_ = nullptr; }
   if (symbol_config_) { symbol_config_->Release(); symbol_config_ = nullptr; }
   if (server_config_) { server_config_->Release(); server_config_ = nullptr; }
+  if (session_config_) { session_config_->Release(); session_config_ = nullptr; }
+  if (holiday_config_) { holiday_config_->Release(); holiday_config_ = nullptr; }
 
   // Reset server API.
   server_ = nullptr;
+
+  // Write buffered logs and stop the log writer thread.
+  LogEngine::Shutdown();
   return MT_RET_OK;
 }
 
@@ -106,12 +197,8 @@ void NonstopRatePlugin::OnPluginUpdate(const IMTConPlugin* plugin) {
   if (!plugin || !server_ || !plugin_config_)
     return;
 
-#ifdef _DEV
-  std::wstringstream ws;
-  ws << "OnPluginUpdate(), plugin_name=" << plugin->Name() 
-     << ", config_name=" << plugin_config_->Name();
-  LogEngine::Journal(INFO, ws.str().c_str());
-#endif
+  JOURNAL(DEBUG, "OnPluginUpdate(), plugin_name=" << plugin->Name()
+                 << ", config_name=" << plugin_config_->Name());
 
   // This event is notified to all plugin, so we need to check plugin name
   // to avoid update unnecessary.
@@ -122,7 +209,9 @@ void NonstopRatePlugin::OnPluginUpdate(const IMTConPlugin* plugin) {
 }
 
 void NonstopRatePlugin::ReadPluginParameters() {
+  LatencyHistogram::Timer timer(latency_[LATENCY_CONFIG_RELOAD]);
   IMTConParam* param;
+  auto start = std::chrono::steady_clock::now();
 
   // Initialize for reading parameters process.
   if (server_->PluginCurrent(plugin_config_) != MT_RET_OK) {
@@ -136,54 +225,431 @@ void NonstopRatePlugin::ReadPluginParameters() {
     return;
   }
 
-  std::unique_lock<std::mutex> lock(sync_mutex_);
-  symbols_.clear();
-  feeder_name_ = std::wstring();
+  // New configuration is built aside, hooks keep using the current one
+  // until it is published.
+  std::lock_guard<std::mutex> lock(sync_mutex_);
+  std::unique_ptr<Config> config(new Config());
+  config->snapshot_max_age_msc = kDefaultSnapshotMaxAge;
+  config->processing_margin_msc = kDefaultProcessingMargin;
+  auto current = config_.Read();
+  config->version = current ? current->version + 1 : 1;
 
+  // Parameters are tokenized in place, only the new configuration allocates.
+  // Parameters rarely change much, size it as the current one.
+  if (current)
+    config->named_rules.Reserve(current->named_rules.Size());
+  size_t rule_order = 0;
   int param_total = plugin_config_->ParameterTotal();
   for (int i = 0; i < param_total; i++) {
     if (plugin_config_->ParameterNext(i, param) != MT_RET_OK)
       continue;
 
-#ifdef _DEV
-    std::wstringstream ws;
-    ws << "ReadParameters(). Raw data: name=" << param->Name() << ", value=" << param->Value();
-    LogEngine::Journal(INFO, ws.str().c_str());
-#endif
-
-    if (common::Trim(param->Name()) == std::wstring(TIMEOUT_PARAM_NAME)) {
-      // Get 'Timeout' value.
-      timeout_ = param->ValueInt();
-      if (timeout_ == 0) timeout_ = kDefaultTimeout;
-      // Suppose process time is 2s, subtract it from real timeout.
-      timeout_ = timeout_ > 2 ? timeout_ - 2 : timeout_;
-    } else if (common::Trim(param->Name()) == std::wstring(FEEDER_PARAM_NAME)) {
-      // Get 'Feeder' value.
-      feeder_name_ = common::Trim(param->ValueString());
-    } else {
-      // Get 'Symbols' value.
-      // Because maximum length of parameter textbox in MT5 is 260 characters.
-      // In case of we have too many characters, create new parameter with 
-      // the following pattern.
-      std::wregex symbol_pattern(L"^\\d{2}\\.Symbols$");
-      std::wstring ws = param->Name();
-      if (std::regex_match(ws, symbol_pattern)) {
-        std::vector<std::wstring> symbol_names = common::Split(param->Value(), L',');
-        for (auto& symbol_name : symbol_names)
-          symbols_[common::Trim(symbol_name)] = RateInfo();
+    JOURNAL(DEBUG, "ReadParameters(). Raw data: name=" << param->Name()
+                   << ", value=" << param->Value());
+
+    switch (param::Classify(param->Name())) {
+      case param::PARAM_TIMEOUT: {
+        // Get 'Timeout' value, in seconds or with "ms" suffix. Without it
+        // symbols use the default one.
+        INT64 timeout = 0;
+        if (!param::ParseDuration(param->ValueString(), timeout)) {
+          JOURNAL(WARNING, "ReadParameters(): invalid timeout " << param->ValueString());
+          timeout = 0;
+        }
+        config->timeout_msc = timeout;
+        break;
+      }
+      case param::PARAM_USE_QUOTES_TIMEOUT:
+        // Get 'UseQuotesTimeout' value.
+        config->use_quotes_timeout = param->ValueInt() != 0;
+        break;
+      case param::PARAM_PROCESSING_MARGIN: {
+        // Get 'ProcessingMargin' value, 0 adds fake rates right at the
+        // timeout.
+        INT64 margin = 0;
+        if (param::ParseDuration(param->ValueString(), margin))
+          config->processing_margin_msc = margin;
+        else
+          JOURNAL(WARNING, "ReadParameters(): invalid processing margin " << param->ValueString());
+        break;
+      }
+      case param::PARAM_FEEDER: {
+        // Get 'Feeder' value.
+        config->feeder_name = common::Trim(param->ValueString());
+        break;
+      }
+      case param::PARAM_LOG_LEVEL: {
+        // Get 'LogLevel' value, records below it are skipped.
+        param::Token level = common::Trim(param->ValueString());
+        if (!LogEngine::ParseSeverity(level.data(), level.size(), config->log_level))
+          JOURNAL(WARNING, "ReadParameters(): unknown log level " << param->ValueString());
+        break;
       }
+      case param::PARAM_SNAPSHOT_MAX_AGE: {
+        // Get 'SnapshotMaxAge' value, 0 disables seeding rates.
+        INT64 max_age = 0;
+        if (param::ParseDuration(param->ValueString(), max_age))
+          config->snapshot_max_age_msc = max_age;
+        else
+          JOURNAL(WARNING, "ReadParameters(): invalid snapshot max age " << param->ValueString());
+        break;
+      }
+      case param::PARAM_PRICE_MODELS:
+        // Get 'PriceModels' value.
+        ReadPriceModels(*config, param->Value());
+        break;
+      case param::PARAM_SYMBOLS:
+        // Get 'Symbols' value.
+        ReadSymbolRules(*config, param->Value(), rule_order);
+        break;
+      default:
+        break;
     }
   }
-  lock.unlock();
+
+  // Rules are resolved once all of them and the plugin timeout are known.
+  ResolveSymbols(*config, current.get());
+  // Newly watched symbols the snapshot has no rate of are seeded from the
+  // server.
+  SeedRates(*config, current.get());
+
+  LogEngine::SetLevel(config->log_level);
 
   // Log all parameters.
-  std::wstringstream message;
-  message << "ReadParameters(): timeout=" << timeout_
-          << ", feeder=" << feeder_name_
-          << ", symbols=";
-  for (auto const& it : symbols_)
-    message << it.first << ",";
-  LogEngine::Journal(INFO, message.str());
+  if (LogEngine::IsEnabled(INFO)) {
+    LogEngine::StreamT message;
+    message << "ReadParameters(): timeout=";
+    if (config->timeout_msc != 0)
+      message << config->timeout_msc << "ms";
+    else
+      message << (config->use_quotes_timeout ? "quotes" : "default");
+    message
+            << ", processing_margin=" << config->processing_margin_msc << "ms"
+            << ", feeder=" << config->feeder_name
+            << ", log_level=" << LogEngine::log_lv[config->log_level]
+            << ", snapshot_max_age=" << config->snapshot_max_age_msc << "ms"
+            << ", rules=" << config->rules.size() + config->named_rules.Size()
+            << ", price_models=" << config->model_rules.size()
+            << ", symbols=" << config->symbols.Size()
+            << ", reload="
+            << std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start).count()
+            << "us";
+    LogEngine::Journal(INFO, message.str());
+  }
+  if (LogEngine::IsEnabled(DEBUG)) {
+    LogEngine::StreamT message;
+    message << "ReadParameters(): watched symbols=";
+    for (auto const& it : config->symbols)
+      message << it.symbol << "("
+              << SymbolTimeout(*config, it.value.timeout_msc,
+                               it.value.info->spec.Load().quotes_timeout)
+              << "ms, " << price_model::Name(it.value.model) << "),";
+    LogEngine::Journal(DEBUG, message.str());
+  }
+
+  // Readers must not publish, release the current configuration first.
+  current.Reset();
+  config_.Publish(std::move(config));
+  WakeAddRate();
+
+  // Main feed may have changed.
+  UpdateMainFeeders();
+}
+
+void NonstopRatePlugin::ReadSymbolRules(Config& config, const wchar_t* value, size_t& order) {
+  for (param::Token item : common::SplitView(value, L',')) {
+    param::SymbolRuleToken token = param::ParseSymbolRule(item);
+    if (token.name.empty())
+      continue;
+
+    INT64 timeout = 0;
+    if (token.has_timeout) {
+      if (token.exclude || !param::ParseDuration(token.timeout, timeout)) {
+        JOURNAL(WARNING, "ReadParameters(): invalid symbol timeout "
+                         << std::wstring(item));
+        timeout = 0;
+      }
+    }
+
+    if (token.exclude || token.name.find_first_of(L"*?") != param::Token::npos) {
+      SymbolRule rule;
+      rule.mask = SymbolMask(token.name);
+      rule.exclude = token.exclude;
+      rule.timeout_msc = timeout;
+      rule.order = order++;
+      config.has_masks = config.has_masks || !rule.exclude;
+      config.rules.push_back(std::move(rule));
+    } else {
+      // Names are copied to a terminated buffer for the table, longer
+      // names are truncated as in the table.
+      wchar_t name[SymbolInformation::kSymbolSize];
+      size_t length = token.name.copy(name, _countof(name) - 1);
+      name[length] = L'\0';
+      NamedRule& rule = config.named_rules.Insert(name);
+      rule.timeout_msc = timeout;
+      rule.order = order++;
+    }
+  }
+}
+
+void NonstopRatePlugin::ReadPriceModels(Config& config, const wchar_t* value) {
+  for (param::Token item : common::SplitView(value, L',')) {
+    param::SymbolRuleToken token = param::ParseSymbolRule(item);
+    if (token.name.empty())
+      continue;
+
+    PriceModelRule rule;
+    if (token.exclude || !price_model::Parse(token.timeout, rule.model)) {
+      JOURNAL(WARNING, "ReadParameters(): invalid price model " << std::wstring(item));
+      continue;
+    }
+    rule.mask = SymbolMask(token.name);
+    config.model_rules.push_back(std::move(rule));
+  }
+}
+
+PriceModel NonstopRatePlugin::MatchPriceModel(const Config& config, const wchar_t* symbol) {
+  for (auto it = config.model_rules.rbegin(); it != config.model_rules.rend(); ++it) {
+    if (it->mask.Match(symbol))
+      return it->model;
+  }
+  return PRICE_JITTER;
+}
+
+INT64 NonstopRatePlugin::SymbolTimeout(const Config& config, INT64 timeout_msc,
+                                       UINT quotes_timeout) {
+  if (timeout_msc == 0) {
+    timeout_msc = config.use_quotes_timeout && quotes_timeout != 0 ?
+                  quotes_timeout * 1000LL : kDefaultTimeout;
+  }
+  return FakeRateTimeout(timeout_msc, config.processing_margin_msc);
+}
+
+void NonstopRatePlugin::ResolveSymbols(Config& config, const Config* current) {
+  UINT symbol_total = config.has_masks ? server_->SymbolTotal() : 0;
+  config.symbols.Reserve(config.named_rules.Size() + symbol_total);
+
+  // Symbols given by name are watched even if they are not configured on
+  // server yet, masks are expanded against symbols configuration.
+  for (auto& rule : config.named_rules)
+    WatchSymbol(config, current, rule.symbol, nullptr);
+  for (UINT pos = 0; pos < symbol_total; pos++) {
+    if (server_->SymbolNext(pos, symbol_config_) == MT_RET_OK)
+      WatchSymbol(config, current, symbol_config_->Symbol(), symbol_config_);
+  }
+}
+
+bool NonstopRatePlugin::WatchSymbol(Config& config, const Config* current,
+                                    const wchar_t* symbol,
+                                    const IMTConSymbol* settings) {
+  INT64 timeout = 0;
+  if (config.symbols.Find(symbol) || !MatchRules(config, symbol, timeout))
+    return false;
+
+  // Keep rates of symbols which are already watched.
+  const WatchedSymbol* watched = current ? current->symbols.Find(symbol) : nullptr;
+  WatchedSymbol& entry = config.symbols.Insert(symbol);
+  entry.timeout_msc = timeout;
+  entry.model = MatchPriceModel(config, symbol);
+  if (watched) {
+    entry.info = watched->info;
+  } else {
+    entry.info = std::make_shared<RateInfo>();
+    CMTStr::Copy(entry.info->symbol, _countof(entry.info->symbol), symbol);
+    entry.info->rand_stream = static_cast<UINT64>(number_engine_()) << 32 | number_engine_();
+    entry.info->snapshot = snapshot_.Acquire(entry.info->symbol);
+    RestoreRate(*entry.info, config.snapshot_max_age_msc);
+    // Symbols events wait for |sync_mutex_|, so no settings change
+    // is lost until the new configuration is published.
+    if (settings)
+      UpdateSymbolSpec(*entry.info, settings);
+    else
+      LoadSymbolSpec(*entry.info);
+  }
+  CheckPriceModel(*entry.info, entry.model);
+  return true;
+}
+
+void NonstopRatePlugin::CheckPriceModel(const RateInfo& info, PriceModel model) {
+  SymbolSpec spec = info.spec.Load();
+  if (model == PRICE_FROZEN_BID && spec.valid && !spec.quote.AskCanMove())
+    JOURNAL(WARNING, "CheckPriceModel(): [" << info.symbol << "] has a fixed spread or a single "
+                     "spread in its filter, frozen_bid cannot move its ask. Use jitter!");
+}
+
+bool NonstopRatePlugin::WatchNewSymbol(Config& config, const Config& current,
+                                       const IMTConSymbol* symbol) {
+  if (!WatchSymbol(config, &current, symbol->Symbol(), symbol))
+    return false;
+  RateInfo& info = *config.symbols.Find(symbol->Symbol())->info;
+  if (config.snapshot_max_age_msc > 0 && !info.state.Load().has_real_rate)
+    SeedRate(info, server_->TimeCurrent() * 1000, config.snapshot_max_age_msc);
+  JOURNAL(DEBUG, "WatchNewSymbol(): [" << info.symbol << "] is watched from now on");
+  return true;
+}
+
+template<typename KeepT>
+size_t NonstopRatePlugin::DropSymbols(Config& config, KeepT keep) {
+  // Entries cannot be removed from a table, the kept ones are copied.
+  SymbolInformation symbols;
+  symbols.Reserve(config.symbols.Size());
+  for (auto& it : config.symbols) {
+    if (config.named_rules.Find(it.symbol) || keep(it.symbol))
+      symbols.Insert(it.symbol) = it.value;
+    else
+      JOURNAL(DEBUG, "DropSymbols(): [" << it.symbol << "] is no longer watched");
+  }
+  size_t dropped = config.symbols.Size() - symbols.Size();
+  if (dropped != 0)
+    config.symbols = std::move(symbols);
+  return dropped;
+}
+
+void NonstopRatePlugin::PublishSymbols(std::unique_ptr<Config> config,
+                                       RcuPtr<Config>::ReadGuard& current) {
+  config->version = current->version + 1;
+  // Readers must not publish, release the current configuration first.
+  current.Reset();
+  config_.Publish(std::move(config));
+  WakeAddRate();
+}
+
+bool NonstopRatePlugin::MatchRules(const Config& config, const wchar_t* symbol,
+                                   INT64& timeout_msc) {
+  // Exclusions win wherever they are, the last matching rule gives the
+  // timeout, so that "*=30,EUR*=1" overrides the generic one.
+  const SymbolRule* last = nullptr;
+  for (auto& rule : config.rules) {
+    if (!rule.mask.Match(symbol))
+      continue;
+    if (rule.exclude)
+      return false;
+    last = &rule;
+  }
+
+  const NamedRule* named = config.named_rules.Find(symbol);
+  if (named && (!last || named->order > last->order))
+    timeout_msc = named->timeout_msc;
+  else if (last)
+    timeout_msc = last->timeout_msc;
+  else
+    return false;
+  if (timeout_msc == 0)
+    timeout_msc = config.timeout_msc;
+  return true;
+}
+
+void NonstopRatePlugin::OpenSnapshot() {
+  std::lock_guard<std::mutex> lock(sync_mutex_);
+  std::wstring path = SnapshotFilePath();
+  if (!snapshot_.Open(path, kSnapshotCapacity)) {
+    JOURNAL(WARNING, "OpenSnapshot(): cannot map " << path
+                     << ", rates are not kept across restarts.");
+    return;
+  }
+  JOURNAL(INFO, "OpenSnapshot(): " << snapshot_.Size() << " of "
+                << snapshot_.Capacity() << " symbols in " << path);
+}
+
+void NonstopRatePlugin::RestoreRate(RateInfo& info, INT64 max_age_msc) {
+  RateSnapshot::Rate rate;
+  if (!info.snapshot || max_age_msc <= 0 || !RateSnapshot::Load(info.snapshot, rate))
+    return;
+  // Server time has a one second precision, newer rates are taken as
+  // received now.
+  INT64 age = std::max<INT64>(0, server_->TimeCurrent() * 1000 - rate.time_msc);
+  if (age > max_age_msc) {
+    JOURNAL(DEBUG, "Snapshot rate of [" << info.symbol << "] is " << age << "ms old. Ignore!");
+    return;
+  }
+
+  // Rate is seen as received |age| ago, so the symbol is due for a fake
+  // rate as if the plugin had kept running.
+  RateState state;
+  state.last_bid = rate.bid;
+  state.last_ask = rate.ask;
+  state.last_rate_msc = rate.time_msc;
+  state.last_real_rate_msc = rate.time_msc;
+  state.last_rate_clock = MonotonicMsc() - age;
+  state.last_real_rate_clock = state.last_rate_clock;
+  state.has_real_rate = true;
+  state.source = RATE_SNAPSHOT;
+  info.state.Store(state);
+  JOURNAL(DEBUG, "Restored rate for [" << info.symbol << "] at @" << rate.time_msc
+                 << ". Bid='" << rate.bid << "', Ask='" << rate.ask << "'");
+}
+
+void NonstopRatePlugin::SeedRates(const Config& config, const Config* current) {
+  if (config.snapshot_max_age_msc <= 0)
+    return;
+  auto start = std::chrono::steady_clock::now();
+  // Symbols watched before the reload were seeded when they were added.
+  std::vector<RateInfo*> pending;
+  for (auto& symbol : config.symbols) {
+    if ((!current || !current->symbols.Find(symbol.symbol)) &&
+        !symbol.value.info->state.Load().has_real_rate)
+      pending.push_back(symbol.value.info.get());
+  }
+  if (pending.empty())
+    return;
+
+  // Each |TickLast| is a lookup in the server history, workers take the
+  // next chunk of symbols until all are done.
+  INT64 server_time_msc = server_->TimeCurrent() * 1000;
+  std::atomic<size_t> next(0);
+  std::atomic<size_t> seeded(0);
+  auto seed = [&]() {
+    size_t begin;
+    while ((begin = next.fetch_add(kSeedChunk)) < pending.size()) {
+      size_t end = std::min(begin + kSeedChunk, pending.size());
+      size_t count = 0;
+      for (size_t i = begin; i < end; i++)
+        count += SeedRate(*pending[i], server_time_msc, config.snapshot_max_age_msc);
+      seeded += count;
+    }
+  };
+  size_t threads = std::min(kSeedThreads, (pending.size() + kSeedChunk - 1) / kSeedChunk);
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < threads; i++)
+    workers.emplace_back(seed);
+  seed();
+  for (auto& worker : workers)
+    worker.join();
+
+  JOURNAL(INFO, "SeedRates(): seeded " << seeded << " of " << pending.size()
+                << " symbols from last ticks on " << threads << " threads in "
+                << std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now() - start).count()
+                << "us");
+}
+
+bool NonstopRatePlugin::SeedRate(RateInfo& info, INT64 server_time_msc, INT64 max_age_msc) {
+  MTTickShort tick = {};
+  if (server_->TickLast(info.symbol, tick) != MT_RET_OK || tick.bid <= 0 || tick.ask <= 0)
+    return false;
+  INT64 time_msc = TickTimeMsc(tick);
+  INT64 age = std::max<INT64>(0, server_time_msc - time_msc);
+  if (age > max_age_msc)
+    return false;
+
+  // Symbols already watched may get a live rate meanwhile, it wins.
+  INT64 clock = MonotonicMsc() - age;
+  bool seeded = false;
+  info.state.Update([&](RateState& state) {
+    if (state.has_real_rate)
+      return;
+    state.last_bid = tick.bid;
+    state.last_ask = tick.ask;
+    state.last_rate_msc = time_msc;
+    state.last_real_rate_msc = time_msc;
+    state.last_rate_clock = clock;
+    state.last_real_rate_clock = clock;
+    state.has_real_rate = true;
+    state.source = RATE_TICK_LAST;
+    seeded = true;
+  });
+  return seeded;
 }
 
 void NonstopRatePlugin::ReadServerParameters() {
@@ -196,7 +662,74 @@ void NonstopRatePlugin::ReadServerParameters() {
   feeder_switch_timeout_ = server_config_->HistoryServer()->DatafeedsTimeout();
 }
 
+void NonstopRatePlugin::UpdateMainFeeders() {
+  // Table is built aside and then published word by word. Each lookup reads
+  // a single word, so a tick sees either the old or the new state of its
+  // datafeed and never waits for the rebuild.
+  std::lock_guard<std::mutex> feeder_lock(feeder_mutex_);
+
+  std::wstring feeder_name;
+  if (auto config = config_.Read())
+    feeder_name = config->feeder_name;
+
+  std::array<UINT64, kMaxFeeders / 64> bits = {};
+  UINT feeder_total = server_->FeederTotal();
+  if (feeder_total > kMaxFeeders) {
+    JOURNAL(WARNING, "UpdateMainFeeders(): only first " << kMaxFeeders
+                     << " of " << feeder_total << " datafeeds are checked.");
+    feeder_total = kMaxFeeders;
+  }
+
+  for (UINT pos = 0; pos < feeder_total; pos++) {
+    if (server_->FeederNext(pos, feeder_config_) != MT_RET_OK)
+      continue;
+    if (common::Trim(feeder_config_->Name()) == feeder_name)
+      bits[pos / 64] |= 1ULL << (pos % 64);
+  }
+
+  for (size_t i = 0; i < bits.size(); i++)
+    main_feeders_[i].store(bits[i], std::memory_order_relaxed);
+}
+
+void NonstopRatePlugin::UpdateMainFeeders(const IMTConFeeder* feeder) {
+  std::wstring feeder_name;
+  if (auto config = config_.Read())
+    feeder_name = config->feeder_name;
+  if (!feeder || common::Trim(feeder->Name()) == feeder_name) {
+    UpdateMainFeeders();
+    return;
+  }
+
+  // Another datafeed changed. The table is still right unless the main
+  // feed was renamed or moved: each marked position must still hold it.
+  {
+    std::lock_guard<std::mutex> feeder_lock(feeder_mutex_);
+    bool current = true;
+    for (UINT word = 0; word < main_feeders_.size() && current; word++) {
+      UINT64 bits = main_feeders_[word].load(std::memory_order_relaxed);
+      for (UINT bit = 0; bits != 0 && current; bit++, bits >>= 1) {
+        if ((bits & 1) == 0)
+          continue;
+        current = server_->FeederNext(word * 64 + bit, feeder_config_) == MT_RET_OK &&
+                  common::Trim(feeder_config_->Name()) == feeder_name;
+      }
+    }
+    if (current)
+      return;
+  }
+  UpdateMainFeeders();
+}
+
+bool NonstopRatePlugin::IsMainFeeder(int feeder_pos) const {
+  if (feeder_pos < 0 || feeder_pos >= kMaxFeeders)
+    return false;
+  UINT64 bits = main_feeders_[feeder_pos / 64].load(std::memory_order_relaxed);
+  return (bits >> (feeder_pos % 64)) & 1;
+}
+
 MTAPIRES NonstopRatePlugin::HookTick(const int feeder, MTTick& tick) {
+  LatencyHistogram::Timer timer(latency_[LATENCY_HOOK_TICK]);
+
   // Based on value of |feeder|, we can identify the data source.
   //  - The MT_FEEDER_DEALER(-1) value means that the quote was added manually 
   //    through a manager terminal or API.
@@ -207,68 +740,70 @@ MTAPIRES NonstopRatePlugin::HookTick(const int feeder, MTTick& tick) {
   // The MT_FEEDER_DEALER and MT_FEEDER_OFFSET values are defined in 
   // EnMTFeederConstants enum.
 
-  std::wstringstream message;
   // If incoming tick is fake tick, which is generated by this plugin
-  // -> update last_rate_time.
+  // -> update last rate time.
   if (feeder == MT_FEEDER_DEALER && IsFake(tick.reserved)) {
-    auto it = symbols_.find(tick.symbol);
-    if (it != symbols_.end()) {
-      std::unique_lock<std::mutex> lock(sync_mutex_);
-      it->second.last_rate_time = tick.datetime;
-      lock.unlock();
+    auto config = config_.Read();
+    const WatchedSymbol* watched =
+        config ? config->symbols.Find(tick.symbol) : nullptr;
+    if (watched) {
+      INT64 time_msc = TickTimeMsc(tick);
+      INT64 clock = MonotonicMsc();
+      watched->info->state.Update([time_msc, clock](RateState& state) {
+        state.last_rate_msc = time_msc;
+        state.last_rate_clock = clock;
+      });
     }
 
-    // Log this tick to file.
-    message << "Received fake rate for [" << tick.symbol << "] "
-            << "with bid=" << tick.bid << ", "
-            << "ask=" << tick.ask << ", "
-            << "feeder_index=" << feeder;
-    LogEngine::Journal(INFO, message.str().c_str());
+    // Log this tick to file. A pass adds a fake rate for each due symbol,
+    // it writes one summary record at INFO.
+    JOURNAL(DEBUG, "Received fake rate for [" << tick.symbol << "] "
+                  << "with bid=" << tick.bid << ", "
+                  << "ask=" << tick.ask << ", "
+                  << "feeder_index=" << feeder);
     return MT_RET_OK;
   }
 
   // Do not care about tick from gateway or manually.
   if (feeder < MT_FEEDER_OFFSET) {
-    message << "HookTick(). Tick is not from feeder, index=" << feeder;
-    LogEngine::Journal(INFO, message.str().c_str());
+    JOURNAL(DEBUG, "HookTick(). Tick is not from feeder, index=" << feeder);
     return MT_RET_OK;
   }
 
-  std::wstring feeder_name;
-  // Get source of tick (data feed name) from feeder index.
-  if (server_->FeederNext(feeder - MT_FEEDER_OFFSET, feeder_config_) != MT_RET_OK)
-    return MT_RET_OK;
-  feeder_name = feeder_config_->Name();
-
   // Just update if ticks/rates are from main feed.
-  if (common::Trim(feeder_name) == feeder_name_)
+  if (IsMainFeeder(feeder - MT_FEEDER_OFFSET))
     UpdateRateInfo(tick);
 
   return MT_RET_OK;
 }
 
 void NonstopRatePlugin::UpdateRateInfo(const MTTick& tick) {
-  std::lock_guard<std::mutex> lock(sync_mutex_);
-
+  LatencyHistogram::Timer timer(latency_[LATENCY_UPDATE_RATE_INFO]);
   // Update rate information if tick/rate is in symbols list.
-  auto it = symbols_.find(tick.symbol);
-  if (it != symbols_.end()) {
+  // Only the symbol's own sequence lock is taken, ticks of other symbols
+  // are handled in parallel.
+  auto config = config_.Read();
+  const WatchedSymbol* watched =
+      config ? config->symbols.Find(tick.symbol) : nullptr;
+  if (watched) {
     // Only update price if it is real tick/rate.
     if (!IsFake(tick.reserved)) {
-      it->second.last_rate_time = tick.datetime;
-      it->second.last_real_rate_time = tick.datetime;
-      it->second.last_bid = tick.bid;
-      it->second.last_ask = tick.ask;
-      it->second.has_real_rate = true;
-
-#ifdef _DEV
-      //std::wstringstream message;
-      //struct tm* time = gmtime(&tick.datetime);
-      //message << "Update rate for [" << tick.symbol
-      //        << "] at @" << time->tm_hour << ":" << time->tm_min << ":" << time->tm_sec
-      //        << ". Bid='" << tick.bid << "', Ask='" << tick.ask;
-      //LogEngine::Journal(INFO, message.str());
-#endif
+      RateState state;
+      state.last_rate_msc = TickTimeMsc(tick);
+      state.last_rate_clock = MonotonicMsc();
+      state.last_real_rate_msc = state.last_rate_msc;
+      state.last_real_rate_clock = state.last_rate_clock;
+      state.last_bid = tick.bid;
+      state.last_ask = tick.ask;
+      state.has_real_rate = true;
+      watched->info->state.Store(state);
+      if (watched->info->snapshot)
+        RateSnapshot::Store(watched->info->snapshot,
+                            RateSnapshot::Rate{ tick.bid, tick.ask, state.last_rate_msc });
+
+      JOURNAL(DEBUG, "Update rate for [" << tick.symbol
+                     << "] at @" << state.last_rate_msc
+                     << ". Bid='" << tick.bid << "', Ask='" << tick.ask << "'");
     } 
   }
 }
@@ -283,90 +818,644 @@ void NonstopRatePlugin::OnConServerUpdate(const IMTConServer* server) {
     feeder_switch_timeout_ =
       const_cast<IMTConServer*>(server)->HistoryServer()->DatafeedsTimeout();
 
-#ifdef _DEV
-    std::wstringstream ws;
-    ws << "OnConServerUpdate(): New feeder switch timeout value is "
-      << feeder_switch_timeout_;
-    LogEngine::Journal(INFO, ws.str());
-#endif
+    JOURNAL(DEBUG, "OnConServerUpdate(): New feeder switch timeout value is "
+                   << feeder_switch_timeout_);
   }
 }
 
+void NonstopRatePlugin::OnFeederAdd(const IMTConFeeder* feeder) {
+  UpdateMainFeeders(feeder);
+}
+
+void NonstopRatePlugin::OnFeederUpdate(const IMTConFeeder* feeder) {
+  // Datafeed may be renamed to or from the main feed name.
+  UpdateMainFeeders(feeder);
+}
+
+void NonstopRatePlugin::OnFeederDelete(const IMTConFeeder* feeder) {
+  // Datafeeds after the deleted one move to a lower position.
+  UpdateMainFeeders(feeder);
+}
+
+void NonstopRatePlugin::OnFeederSync(void) {
+  // Datafeeds may be reordered (FeederShift) or synchronized from the
+  // main trade server.
+  UpdateMainFeeders();
+}
+
+void NonstopRatePlugin::OnSymbolAdd(const IMTConSymbol* symbol) {
+  if (!symbol)
+    return;
+  std::lock_guard<std::mutex> lock(sync_mutex_);
+  auto config = config_.Read();
+  if (!config)
+    return;
+  const WatchedSymbol* watched = config->symbols.Find(symbol->Symbol());
+  if (watched) {
+    UpdateSymbolSpec(*watched->info, symbol);
+    CheckPriceModel(*watched->info, watched->model);
+    return;
+  }
+  // New symbol may match a mask, watch it from now on.
+  INT64 timeout = 0;
+  if (!config->has_masks || !MatchRules(*config, symbol->Symbol(), timeout))
+    return;
+  std::unique_ptr<Config> changed(new Config(*config));
+  if (WatchNewSymbol(*changed, *config, symbol))
+    PublishSymbols(std::move(changed), config);
+}
+
+void NonstopRatePlugin::OnSymbolUpdate(const IMTConSymbol* symbol) {
+  if (!symbol)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(sync_mutex_);
+    auto config = config_.Read();
+    if (!config)
+      return;
+    const WatchedSymbol* watched = config->symbols.Find(symbol->Symbol());
+    if (watched) {
+      UpdateSymbolSpec(*watched->info, symbol);
+      CheckPriceModel(*watched->info, watched->model);
+      return;
+    }
+    // A rename is notified with the new name only. Like |OnSymbolDelete|,
+    // symbols matched by a mask which are no longer configured are dropped.
+    if (config->has_masks) {
+      std::unique_ptr<Config> changed(new Config(*config));
+      if (DropSymbols(*changed, [this, &config](const wchar_t* name) {
+            if (server_->SymbolGet(name, symbol_config_) == MT_RET_OK)
+              return true;
+            UpdateSymbolSpec(*config->symbols.Find(name)->info, nullptr);
+            return false;
+          }) != 0)
+        PublishSymbols(std::move(changed), config);
+    }
+  }
+  // The new name may match a mask.
+  OnSymbolAdd(symbol);
+}
+
+void NonstopRatePlugin::OnSymbolDelete(const IMTConSymbol* symbol) {
+  if (!symbol)
+    return;
+  std::lock_guard<std::mutex> lock(sync_mutex_);
+  auto config = config_.Read();
+  const WatchedSymbol* watched =
+      config ? config->symbols.Find(symbol->Symbol()) : nullptr;
+  if (!watched)
+    return;
+  // Symbols given by name stay watched until they are configured again,
+  // symbols matched by a mask are dropped.
+  UpdateSymbolSpec(*watched->info, nullptr);
+  if (config->named_rules.Find(symbol->Symbol()))
+    return;
+  std::unique_ptr<Config> changed(new Config(*config));
+  const wchar_t* deleted = symbol->Symbol();
+  if (DropSymbols(*changed, [deleted](const wchar_t* name) {
+        return CMTStr::Compare(name, deleted) != 0;
+      }) != 0)
+    PublishSymbols(std::move(changed), config);
+}
+
+void NonstopRatePlugin::OnSymbolSync(void) {
+  std::lock_guard<std::mutex> lock(sync_mutex_);
+  auto config = config_.Read();
+  if (!config)
+    return;
+  UpdateSymbolSpecs(*config);
+  if (!config->has_masks)
+    return;
+
+  // Symbols may have been added or deleted. Masks are expanded against
+  // the symbols configuration once for the whole synchronization, and the
+  // watched symbols change only if some symbols do.
+  std::unique_ptr<Config> changed(new Config(*config));
+  size_t added = 0;
+  SymbolTable<bool> configured;
+  UINT symbol_total = server_->SymbolTotal();
+  configured.Reserve(symbol_total);
+  for (UINT pos = 0; pos < symbol_total; pos++) {
+    if (server_->SymbolNext(pos, symbol_config_) != MT_RET_OK)
+      continue;
+    const wchar_t* name = symbol_config_->Symbol();
+    configured.Insert(name) = true;
+    INT64 timeout = 0;
+    if (!config->symbols.Find(name) && MatchRules(*config, name, timeout))
+      added += WatchNewSymbol(*changed, *config, symbol_config_);
+  }
+  size_t dropped = DropSymbols(*changed, [&configured](const wchar_t* name) {
+    return configured.Find(name) != nullptr;
+  });
+  if (added == 0 && dropped == 0)
+    return;
+  JOURNAL(INFO, "OnSymbolSync(): " << added << " symbols watched from now on, "
+                << dropped << " no longer watched");
+  PublishSymbols(std::move(changed), config);
+}
+
+void NonstopRatePlugin::UpdateSymbolSpec(RateInfo& info, const IMTConSymbol* symbol) {
+  SymbolSpec spec;
+  if (symbol) {
+    spec.valid = true;
+    spec.quote = QuoteLimits(symbol->Digits(), symbol->TickSize(), symbol->Spread(),
+                             symbol->SpreadBalance(), symbol->FilterSpreadMin(),
+                             symbol->FilterSpreadMax());
+    spec.quotes_timeout = symbol->QuotesTimeout();
+    spec.schedule = BuildSchedule(symbol);
+  }
+  // Closed symbols may have to be woken up earlier or put to sleep, and a
+  // new quotes timeout changes the deadline of symbols using it.
+  // The spec is stored first, so the AddRate thread seeing the new version
+  // reads the new spec.
+  SymbolSpec previous = info.spec.Load();
+  info.spec.Store(spec);
+  if (spec.schedule != previous.schedule || spec.quotes_timeout != previous.quotes_timeout) {
+    schedules_version_++;
+    WakeAddRate();
+  }
+}
+
+void NonstopRatePlugin::LoadSymbolSpec(RateInfo& info) {
+  bool found = server_->SymbolGet(info.symbol, symbol_config_) == MT_RET_OK;
+  UpdateSymbolSpec(info, found ? symbol_config_ : nullptr);
+}
+
+void NonstopRatePlugin::UpdateSymbolSpecs(const Config& config) {
+  for (auto& symbol : config.symbols)
+    LoadSymbolSpec(*symbol.value.info);
+}
+
+void NonstopRatePlugin::OnHolidayAdd(const IMTConHoliday* holiday) {
+  // Disabled holidays do not change quote schedules.
+  if (holiday && holiday->Mode() == IMTConHoliday::HOLIDAY_ENABLED)
+    UpdateHolidays();
+}
+
+void NonstopRatePlugin::OnHolidayUpdate(const IMTConHoliday* holiday) {
+  // The previous state of the holiday is not given, an enabled holiday may
+  // have been disabled: |UpdateHolidays| compares the holidays instead.
+  if (holiday)
+    UpdateHolidays();
+}
+
+void NonstopRatePlugin::OnHolidayDelete(const IMTConHoliday* holiday) {
+  if (holiday && holiday->Mode() == IMTConHoliday::HOLIDAY_ENABLED)
+    UpdateHolidays();
+}
+
+void NonstopRatePlugin::OnHolidaySync(void) {
+  UpdateHolidays();
+}
+
+void NonstopRatePlugin::UpdateHolidays() {
+  std::lock_guard<std::mutex> lock(sync_mutex_);
+  std::vector<HolidayRule> previous = std::move(holidays_);
+  LoadHolidays();
+  // Schedules of all watched symbols are rebuilt only if enabled holidays
+  // have changed.
+  if (holidays_ == previous)
+    return;
+  if (auto config = config_.Read())
+    UpdateSymbolSpecs(*config);
+}
+
+void NonstopRatePlugin::LoadHolidays() {
+  holidays_.clear();
+  UINT holiday_total = server_->HolidayTotal();
+  for (UINT pos = 0; pos < holiday_total; pos++) {
+    if (server_->HolidayNext(pos, holiday_config_) != MT_RET_OK ||
+        holiday_config_->Mode() != IMTConHoliday::HOLIDAY_ENABLED)
+      continue;
+    HolidayRule rule;
+    rule.holiday.year = holiday_config_->Year();
+    rule.holiday.month = holiday_config_->Month();
+    rule.holiday.day = holiday_config_->Day();
+    rule.holiday.work_from = holiday_config_->WorkFrom();
+    rule.holiday.work_to = holiday_config_->WorkTo();
+    UINT symbol_total = holiday_config_->SymbolTotal();
+    for (UINT i = 0; i < symbol_total; i++) {
+      if (LPCWSTR path = holiday_config_->SymbolNext(i))
+        rule.symbols.emplace_back(path);
+    }
+    holidays_.push_back(std::move(rule));
+  }
+  JOURNAL(DEBUG, "LoadHolidays(): " << holidays_.size() << " of "
+                 << holiday_total << " holidays are enabled.");
+}
+
+const QuoteSchedule* NonstopRatePlugin::BuildSchedule(const IMTConSymbol* symbol) {
+  QuoteSchedule schedule;
+  for (UINT wday = 0; wday < QuoteSchedule::kDaysInWeek; wday++) {
+    UINT session_total = symbol->SessionQuoteTotal(wday);
+    for (UINT pos = 0; pos < session_total; pos++) {
+      if (symbol->SessionQuoteNext(wday, pos, session_config_) == MT_RET_OK)
+        schedule.AddSession(wday, session_config_->Open(), session_config_->Close());
+    }
+  }
+  // Holidays are given for symbol groups, as "Forex\*".
+  for (auto& rule : holidays_) {
+    for (auto& mask : rule.symbols) {
+      if (mask.Match(symbol->Path()) || mask.Match(symbol->Symbol())) {
+        schedule.AddHoliday(rule.holiday);
+        break;
+      }
+    }
+  }
+  if (schedule.AlwaysOpen())
+    return nullptr;
+
+  for (auto& shared : schedules_) {
+    if (*shared == schedule)
+      return shared.get();
+  }
+  schedules_.emplace_back(new QuoteSchedule(std::move(schedule)));
+  return schedules_.back().get();
+}
+
 void NonstopRatePlugin::AddRate() {
   LogEngine::Journal(INFO, L"AddRate thread start.");
 
-  std::uniform_int_distribution<int> dist(0, 4);
-  while (!stop_thread_) {
-    // Checking to add fake rate every |kAddRateIntervalTime| milliseconds.
-    std::this_thread::sleep_for(std::chrono::milliseconds(kAddRateIntervalTime));
-
-    std::unique_lock<std::mutex> lock(add_rate_mutex_);
-    for (auto symbol : symbols_) {
-      // Get current time.
-      time_t curr_time = server_->TimeCurrent();
-
-      std::wstringstream message;
-      // Add fake rate when time is in [time_out_, feeder_switch_timeout).
-      // Otherwise, do nothing.
-      if (curr_time - symbol.second.last_rate_time < timeout_ ||
-          feeder_switch_timeout_ <= curr_time - symbol.second.last_real_rate_time)
-        continue;
+  // Each symbol waits in the wheel until its last rate is |timeout| old.
+  // Hooks do not touch the wheel: when a symbol is due, its deadline is
+  // computed again from its last rate and it is moved if rates came
+  // meanwhile, so a healthy feed costs one check per symbol and timeout.
+  TimerWheel<std::shared_ptr<RateInfo>> wheel(MonotonicMsc(), kTimerResolution);
+  UINT64 scheduled_version = 0;
+  UINT64 scheduled_schedules = 0;
+  // Fake rates of one pass. They are pushed to the server once the pass is
+  // built and the configuration released, room is kept for all symbols.
+  FakeRatePass pass;
+  // Totals of the last fake rates results and latency summaries.
+  INT64 next_report = MonotonicMsc() + kStatsPeriod;
+  UINT64 reported_accepted = 0, reported_rejected = 0;
+  std::array<LatencyHistogram::Snapshot, LATENCY_METRIC_NUM> reported_latency;
 
-      // If there are no real rate for this symbol, 
-      // do not handle even timeout condition is satisfied.
-      if (!symbol.second.has_real_rate) {
-        message << "Symbol [" << symbol.first << "] has no real rate. Ignore!";
-        LogEngine::Journal(INFO, message.str());
-        continue;
-      }
+  while (true) {
+    // Sleep until the next due symbol or summary, or until woken up by a
+    // configuration change. An idle plugin does not poll the wheel.
+    {
+      INT64 wake_time = next_report;
+      INT64 deadline = wheel.NextDeadline();
+      if (deadline >= 0 && deadline < wake_time)
+        wake_time = deadline;
+      auto sleep = std::chrono::milliseconds(std::max<INT64>(0, wake_time - MonotonicMsc()));
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      wake_cv_.wait_for(lock, sleep, [this] { return wake_ || stop_thread_; });
+      if (stop_thread_)
+        break;
+      wake_ = false;
+    }
+
+    if (MonotonicMsc() >= next_report) {
+      ReportTickStats(reported_accepted, reported_rejected);
+      ReportLatency(reported_latency);
+      next_report = MonotonicMsc() + kStatsPeriod;
+    }
+
+    pass.Clear();
+    uint64_t pass_start = LatencyHistogram::Now();
+    auto build_start = std::chrono::steady_clock::now();
+    if (!BuildFakeRates(wheel, scheduled_version, scheduled_schedules, pass))
+      continue;
+    auto push_start = std::chrono::steady_clock::now();
 
-      MTTick data { 0 };
-      // Fill fake data.
-      // Symbol.
-      std::copy(symbol.first.begin(), symbol.first.end(), data.symbol);
-      // Description.
-      std::copy(kFakeRateReservedBytes, kFakeRateReservedBytes + 4, data.reserved);
-      // Do not add time for tick, history server will do it for you.
-      data.datetime = curr_time;
-      // Get symbol config.
-      if (server_->SymbolGet(symbol.first.c_str(), symbol_config_) != MT_RET_OK)
+    // Add them to price stream, ticks come back through HookTick.
+    size_t added = 0;
+    for (size_t i = 0; i < pass.ticks.size(); i++) {
+      MTAPIRES res = server_->TickAdd(pass.ticks[i]);
+      RateInfo& info = *pass.symbols[i];
+      UINT64 rejected = info.tick_results.Add(res);
+      if (res == MT_RET_OK) {
+        added++;
         continue;
-      // Fake bid/ask.
-      int rand;
-      int digits = symbol_config_->Digits();
-      while ((rand = dist(number_engine_) - 2) == symbol.second.last_rand);
-      double offset = rand * std::pow(10, -digits);
-      data.bid = symbol.second.last_bid + offset;
-      data.ask = symbol.second.last_ask + offset;
-      // Save current 'rand' value for future comparing.
-      symbols_[symbol.first].last_rand = rand;
-
-      // Change precision to show changing amount of bid/ask in log.
-      message.precision(digits + 10);
-      message << "Generated fake rate for [" << symbol.first
-              << "] with old_bid=" << symbol.second.last_bid
-              << ", fake_bid=" << data.bid
-              << ", old_ask=" << symbol.second.last_ask
-              << ", fake_ask=" << data.ask
-              << ", offset=" << offset;
-      LogEngine::Journal(INFO, message.str());
-
-      // Add it to price stream.
-      server_->TickAdd(data);
+      }
+      // The first rejection of a symbol is reported, all are counted.
+      if (rejected == 1)
+        JOURNAL(WARNING, "AddRate(): fake rate for [" << info.symbol << "] rejected: "
+                         << SMTFormat::FormatError(res) << " (" << res << "), bid="
+                         << pass.ticks[i].bid << ", ask=" << pass.ticks[i].ask);
+      else
+        JOURNAL(DEBUG, "AddRate(): fake rate for [" << info.symbol << "] rejected: "
+                       << SMTFormat::FormatError(res) << " (" << res << "), "
+                       << rejected << " rejected so far");
     }
 
-    lock.unlock();
+    auto pass_end = std::chrono::steady_clock::now();
+    latency_[LATENCY_ADD_RATE_PASS].Record(LatencyHistogram::Now() - pass_start);
+
+    using std::chrono::microseconds;
+    JOURNAL(INFO, "AddRate(): added " << added << " of " << pass.ticks.size()
+                  << " fake rates (" << pass.seeded << " from seeded rates), build="
+                  << std::chrono::duration_cast<microseconds>(push_start - build_start).count()
+                  << "us, push="
+                  << std::chrono::duration_cast<microseconds>(pass_end - push_start).count()
+                  << "us");
   }
 
   LogEngine::Journal(INFO, L"AddRate thread stop.");
 }
 
+void NonstopRatePlugin::TickStats(std::vector<SymbolTickStats>& stats) const {
+  stats.clear();
+  auto config = config_.Read();
+  if (!config)
+    return;
+  stats.reserve(config->symbols.Size());
+  for (auto& symbol : config->symbols) {
+    const TickAddCounters& results = symbol.value.info->tick_results;
+    stats.emplace_back();
+    SymbolTickStats& entry = stats.back();
+    CMTStr::Copy(entry.symbol, _countof(entry.symbol), symbol.symbol);
+    entry.accepted = results.Accepted();
+    entry.rejected = results.Rejected();
+    results.Rejections(entry.rejections);
+  }
+}
+
+const char* NonstopRatePlugin::LatencyName(LatencyMetric metric) {
+  static const char* const kNames[LATENCY_METRIC_NUM] =
+      { "HookTick", "UpdateRateInfo", "ConfigReload", "AddRatePass" };
+  return metric >= 0 && metric < LATENCY_METRIC_NUM ? kNames[metric] : "";
+}
+
+void NonstopRatePlugin::Latency(LatencyMetric metric, LatencyHistogram::Snapshot& snapshot) const {
+  if (metric >= 0 && metric < LATENCY_METRIC_NUM)
+    latency_[metric].Read(snapshot);
+  else
+    snapshot = LatencyHistogram::Snapshot();
+}
+
+void NonstopRatePlugin::ReportLatency(
+    std::array<LatencyHistogram::Snapshot, LATENCY_METRIC_NUM>& previous) const {
+  for (int i = 0; i < LATENCY_METRIC_NUM; i++) {
+    LatencyMetric metric = static_cast<LatencyMetric>(i);
+    LatencyHistogram::Snapshot current;
+    Latency(metric, current);
+    LatencyHistogram::Snapshot period = current;
+    period.Subtract(previous[i]);
+    previous[i] = std::move(current);
+    if (period.count == 0)
+      continue;
+    JOURNAL(INFO, "Latency(): " << LatencyName(metric) << " last " << kStatsPeriod / 1000
+                  << "s count=" << period.count << ", mean=" << period.Mean()
+                  << "ns, p50=" << period.Percentile(50) << "ns, p90=" << period.Percentile(90)
+                  << "ns, p99=" << period.Percentile(99) << "ns, p99.9=" << period.Percentile(99.9)
+                  << "ns, max=" << period.Max() << "ns");
+  }
+}
+
+void NonstopRatePlugin::ReportTickStats(UINT64& accepted, UINT64& rejected) const {
+  std::vector<SymbolTickStats> stats;
+  TickStats(stats);
+
+  // Totals per result code, codes are few.
+  UINT64 total_accepted = 0, total_rejected = 0;
+  size_t rejecting = 0;
+  std::vector<TickAddCounters::Count> codes;
+  for (auto& entry : stats) {
+    total_accepted += entry.accepted;
+    total_rejected += entry.rejected;
+    rejecting += entry.rejected != 0;
+    TickAddCounters::Merge(codes, entry.rejections);
+  }
+  // Symbols removed from parameters take their counters with them.
+  UINT64 period_accepted = total_accepted > accepted ? total_accepted - accepted : 0;
+  UINT64 period_rejected = total_rejected > rejected ? total_rejected - rejected : 0;
+  accepted = total_accepted;
+  rejected = total_rejected;
+  if (period_accepted == 0 && period_rejected == 0)
+    return;
+
+  if (LogEngine::IsEnabled(INFO)) {
+    LogEngine::StreamT message;
+    message << "TickStats(): last " << kStatsPeriod / 1000 << "s accepted="
+            << period_accepted << ", rejected=" << period_rejected
+            << "; total accepted=" << total_accepted << ", rejected=" << total_rejected
+            << " of " << rejecting << " symbols";
+    for (auto& code : codes) {
+      if (code.other)
+        message << ", other codes=" << code.count;
+      else
+        message << ", " << SMTFormat::FormatError(code.code) << " (" << code.code << ")="
+                << code.count;
+    }
+    // Most rejected symbols.
+    size_t top = std::min(kTickStatsTopSymbols, rejecting);
+    if (top != 0) {
+      auto more_rejected = [](const SymbolTickStats& left, const SymbolTickStats& right) {
+        return left.rejected > right.rejected;
+      };
+      std::partial_sort(stats.begin(), stats.begin() + top, stats.end(), more_rejected);
+      message << "; most rejected:";
+      for (size_t i = 0; i < top; i++)
+        message << " " << stats[i].symbol << "(" << stats[i].rejected << ")";
+    }
+    LogEngine::Journal(INFO, message.str());
+  }
+}
+
+bool NonstopRatePlugin::BuildFakeRates(TimerWheel<std::shared_ptr<RateInfo>>& wheel,
+                                       UINT64& scheduled_version,
+                                       UINT64& scheduled_schedules,
+                                       FakeRatePass& pass) {
+  // Parameters may change meanwhile, keep working on the current ones.
+  auto config = config_.Read();
+  if (!config)
+    return false;
+
+  INT64 now = MonotonicMsc();
+  // Server time, read once per pass if a symbol with sessions is due.
+  INT64 server_time = -1;
+
+  // Schedule new symbols, and all symbols again if their timeout or their
+  // quote sessions changed.
+  UINT64 schedules_version = schedules_version_;
+  if (config->version != scheduled_version || schedules_version != scheduled_schedules) {
+    pass.ticks.reserve(config->symbols.Size());
+    pass.symbols.reserve(config->symbols.Size());
+    pass.models.reserve(config->symbols.Size());
+    pass.positions.reserve(config->symbols.Size());
+    pass.limits.reserve(config->symbols.Size());
+    for (auto& batch : pass.prices)
+      batch.Reserve(config->symbols.Size());
+    for (auto& symbol : config->symbols) {
+      RateInfo& info = *symbol.value.info;
+      INT64 timeout = SymbolTimeout(*config, symbol.value.timeout_msc,
+                                    info.spec.Load().quotes_timeout);
+      INT64 deadline = info.state.Load().last_rate_clock + timeout;
+      if (deadline != info.deadline) {
+        info.deadline = deadline;
+        wheel.Schedule(deadline, symbol.value.info);
+      }
+    }
+    scheduled_version = config->version;
+    scheduled_schedules = schedules_version;
+  }
+
+  wheel.Advance(now, [&](INT64 deadline, std::shared_ptr<RateInfo>& entry) {
+    RateInfo& info = *entry;
+    // Symbol was scheduled again later.
+    if (deadline != info.deadline)
+      return;
+    // Symbol was removed from parameters.
+    const WatchedSymbol* watched = config->symbols.Find(info.symbol);
+    if (!watched || watched->info != entry) {
+      info.deadline = 0;
+      return;
+    }
+    PriceModel model = watched->model;
+    // Deadline was further than the wheel range.
+    if (deadline > now) {
+      wheel.Schedule(deadline, entry);
+      return;
+    }
+    SymbolSpec spec = info.spec.Load();
+    INT64 timeout = SymbolTimeout(*config, watched->timeout_msc, spec.quotes_timeout);
+
+    // Consistent copy of the rates, hooks may update them meanwhile.
+    RateState state = info.state.Load();
+    INT64 due = state.last_rate_clock + timeout;
+    if (due > now) {
+      info.deadline = due;
+      wheel.Schedule(due, entry);
+      return;
+    }
+
+    // Closed symbols sleep until their next quote session instead of being
+    // checked every |timeout|. Server time has a one second precision, so
+    // they may wake up to one second late.
+    if (const QuoteSchedule* schedule = spec.schedule) {
+      if (server_time < 0)
+        server_time = server_->TimeCurrent();
+      INT64 open = schedule->NextOpen(server_time);
+      if (open != server_time) {
+        JOURNAL(DEBUG, "Symbol [" << info.symbol << "] is closed, next quote session in "
+                       << (open < 0 ? -1 : open - server_time) << "s");
+        // Closed beyond the look-ahead: search again from there.
+        INT64 wait = open < 0 ? QuoteSchedule::kLookAheadDays * QuoteSchedule::kMinutesInDay * 60LL
+                              : open - server_time;
+        info.deadline = now + wait * 1000;
+        wheel.Schedule(info.deadline, entry);
+        return;
+      }
+    }
+
+    // Check again after |timeout| if no rate comes.
+    info.deadline = now + timeout;
+    wheel.Schedule(info.deadline, entry);
+
+    if (BuildFakeRate(info, state, model, now, pass))
+      pass.seeded += state.source != RATE_LIVE;
+  });
+  if (pass.ticks.empty())
+    return false;
+
+  // Prices of all due symbols at once, the model is dispatched once per
+  // batch.
+  for (int model = 0; model < PRICE_MODEL_NUM; model++) {
+    if (pass.prices[model].Size() != 0)
+      pass.prices[model].Generate(static_cast<PriceModel>(model));
+  }
+  for (size_t i = 0; i < pass.ticks.size(); i++) {
+    MTTick& data = pass.ticks[i];
+    RateInfo& info = *pass.symbols[i];
+    const FakePriceBatch& prices = pass.prices[pass.models[i]];
+    size_t pos = pass.positions[i];
+    data.bid = prices.bid[pos];
+    data.ask = prices.ask[pos];
+    // Keep them on the price grid and within the spread settings, the
+    // server filters would reject them otherwise. A frozen bid is kept.
+    if (pass.models[i] == PRICE_FROZEN_BID)
+      pass.limits[i].FitAsk(data.bid, data.ask);
+    else
+      pass.limits[i].Fit(data.bid, data.ask);
+    info.last_rand = prices.last_offset[pos];
+    info.rand_counter = prices.counter[pos];
+
+    // Change precision to show changing amount of bid/ask in log. The pass
+    // writes one summary record, details are for development only.
+    JOURNAL(DEBUG, std::setprecision(15)
+                  << "Generated fake rate for [" << info.symbol
+                  << "] with fake_bid=" << data.bid
+                  << ", fake_ask=" << data.ask
+                  << ", offset=" << info.last_rand << " ticks");
+  }
+  return true;
+}
+
+bool NonstopRatePlugin::BuildFakeRate(RateInfo& info, const RateState& state,
+                                      PriceModel model, INT64 now, FakeRatePass& pass) {
+  // Add fake rate when time is in [time_out_, feeder_switch_timeout).
+  // Otherwise, do nothing.
+  if (feeder_switch_timeout_ * 1000LL <= now - state.last_real_rate_clock)
+    return false;
+
+  // If there are no real rate for this symbol, 
+  // do not handle even timeout condition is satisfied.
+  if (!state.has_real_rate) {
+    JOURNAL(DEBUG, "Symbol [" << info.symbol << "] has no real rate. Ignore!");
+    return false;
+  }
+
+  // Symbol settings, skip symbols which are not configured on server.
+  SymbolSpec spec = info.spec.Load();
+  if (!spec.valid)
+    return false;
+
+  // The last tick of the server may be a fake rate of a previous run, so
+  // prices only jitter around it until a real rate comes: a walk would
+  // drift further from an unconfirmed price.
+  if (state.source == RATE_TICK_LAST && (model == PRICE_WALK || model == PRICE_REVERT))
+    model = PRICE_JITTER;
+  // Ask of a frozen bid could not move, see |CheckPriceModel|.
+  if (model == PRICE_FROZEN_BID && !spec.quote.AskCanMove())
+    model = PRICE_JITTER;
+
+  pass.ticks.push_back(MTTick{ 0 });
+  MTTick& data = pass.ticks.back();
+  // Fill fake data.
+  // Symbol.
+  std::copy(info.symbol, info.symbol + _countof(info.symbol), data.symbol);
+  // Description.
+  std::copy(kFakeRateReservedBytes, kFakeRateReservedBytes + 4, data.reserved);
+  // Time of the last rate moved forward by the monotonic time elapsed since
+  // it came, so fake rates follow the feed clock with millisecond precision.
+  data.datetime_msc = state.last_rate_msc + (now - state.last_rate_clock);
+  data.datetime = data.datetime_msc / 1000;
+  // Fake bid/ask are moved from the last ones by the pass.
+  pass.symbols.push_back(&info);
+  pass.models.push_back(model);
+  pass.positions.push_back(pass.prices[model].Add(state.last_bid, state.last_ask,
+                                                  spec.quote.TickSize(), info.last_rand,
+                                                  info.rand_stream, info.rand_counter));
+  pass.limits.push_back(spec.quote);
+  return true;
+}
+
+void NonstopRatePlugin::WakeAddRate() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    wake_ = true;
+  }
+  wake_cv_.notify_one();
+}
+
 void NonstopRatePlugin::StartAddRateThread() {
-  stop_thread_ = false;
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    stop_thread_ = false;
+    // First pass schedules the watched symbols.
+    wake_ = true;
+  }
   add_rate_thread_ = std::thread(&NonstopRatePlugin::AddRate, this);
 }
 
 void NonstopRatePlugin::StopAddRateThread() {
-  stop_thread_ = true;
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    stop_thread_ = true;
+  }
+  wake_cv_.notify_one();
   add_rate_thread_.join();
 }
@@ -1,37 +1,122 @@
 #pragma once
 
-#include <map>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <random>
 #include <string>
+#include <vector>
 
+#include "fake_price.h"
+#include "latency_histogram.h"
 #include "log.h"
+#include "quote_schedule.h"
+#include "rate_snapshot.h"
+#include "rcu_ptr.h"
+#include "seqlock.h"
+#include "symbol_mask.h"
+#include "symbol_table.h"
+#include "tick_stats.h"
+#include "timer_wheel.h"
 
 // This class represent for plugin behavior.
 // Only run on history server.
 class NonstopRatePlugin : public IMTServerPlugin,
                           public IMTConPluginSink,
                           public IMTTickSink,
-                          public IMTConServerSink {
+                          public IMTConServerSink,
+                          public IMTConFeederSink,
+                          public IMTConSymbolSink,
+                          public IMTConHolidaySink {
 public:
+  // Where the last real rate of a symbol comes from. Seeded rates were not
+  // received by this plugin instance: the snapshot holds main feed rates
+  // of a previous run, the last tick of the server may come from any
+  // source, fake rates of a previous run included. Prices do not drift
+  // away from a last tick, see |BuildFakeRate|.
+  enum RateSource {
+    RATE_LIVE,
+    RATE_SNAPSHOT,
+    RATE_TICK_LAST,
+  };
+
+  // Last rates of a symbol. Written by tick hooks and read by the AddRate
+  // thread as one consistent snapshot.
+  struct RateState {
+    double last_bid = 0;
+    double last_ask = 0;
+    // Time (milliseconds) of the last real rate and of the last rate, fake
+    // rates included, as stamped by the feed.
+    INT64 last_real_rate_msc = 0;
+    INT64 last_rate_msc = 0;
+    // Monotonic clock (milliseconds) when they were received. Staleness is
+    // measured on it, so it is not affected by server time changes.
+    INT64 last_real_rate_clock = 0;
+    INT64 last_rate_clock = 0;
+    bool has_real_rate = false;
+    RateSource source = RATE_LIVE;
+  };
+
+  // Symbol settings used to build fake rates, cached from the symbols
+  // configuration so that the AddRate thread does not query the server.
+  struct SymbolSpec {
+    // Symbol exists in the server configuration.
+    bool valid = false;
+    // Digits, tick size, spread and spread filter of the quotes.
+    QuoteLimits quote;
+    // Symbol quotes timeout (seconds), 0 if not set. Fake rate timeout of
+    // the symbol when parameters give none and ask for it.
+    UINT quotes_timeout = 0;
+    // Quote sessions and holidays of the symbol, nullptr if it is always
+    // open. Owned by |schedules_|.
+    const QuoteSchedule* schedule = nullptr;
+  };
+
   struct RateInfo {
-    double last_bid;
-    double last_ask;
-    time_t last_real_rate_time;
-    time_t last_rate_time;
+    // Each symbol has its own sequence lock, so hooks of different symbols
+    // never contend and the AddRate thread never blocks them.
+    SeqLock<RateState> state;
+    // Written on symbols configuration changes, read by AddRate thread.
+    SeqLock<SymbolSpec> spec;
+    // Symbol name.
+    wchar_t symbol[32];
+    // Last real rate persisted across restarts, nullptr if the snapshot
+    // is not available. Written by tick hooks.
+    RateSnapshot::Slot* snapshot;
+    // Previous fake price offset (ticks) from the last real rates, random
+    // stream of offsets and draws taken from it. Only used by AddRate
+    // thread.
     int last_rand;
-    bool has_real_rate;
+    UINT64 rand_stream;
+    UINT64 rand_counter;
+    // Deadline this symbol is scheduled for in the timer wheel, 0 if it is
+    // not scheduled. Only used by AddRate thread.
+    INT64 deadline;
+    // Results of |TickAdd| for fake rates of this symbol. Written by
+    // AddRate thread, read by any.
+    TickAddCounters tick_results;
 
     RateInfo() {
-      last_bid = 0;
-      last_ask = 0;
-      last_real_rate_time = 0;
-      last_rate_time = 0;
+      symbol[0] = L'\0';
+      snapshot = nullptr;
       last_rand = 0;
-      has_real_rate = false;
+      rand_stream = 0;
+      rand_counter = 0;
+      deadline = 0;
     }
   };
 
+  // Fake rates of a watched symbol added to the server.
+  struct SymbolTickStats {
+    wchar_t symbol[32];
+    UINT64 accepted = 0;
+    UINT64 rejected = 0;
+    // Rejected fake rates per |TickAdd| result code.
+    std::vector<TickAddCounters::Count> rejections;
+  };
+
   NonstopRatePlugin(void);
   virtual ~NonstopRatePlugin(void);
 
@@ -39,7 +124,32 @@ public:
   virtual void Release(void);
   virtual MTAPIRES Start(IMTServerAPI* server);
   virtual MTAPIRES Stop(void);
+
+  // Snapshot of fake rates results of all watched symbols, in no order.
+  // Counters are read without locking, from any thread.
+  void TickStats(std::vector<SymbolTickStats>& stats) const;
+
+  // Measured code paths.
+  enum LatencyMetric {
+    // Whole tick hook, on server tick threads.
+    LATENCY_HOOK_TICK,
+    // Rates update of a main feed tick, part of the tick hook.
+    LATENCY_UPDATE_RATE_INFO,
+    // Plugin parameters reload, including symbols resolution.
+    LATENCY_CONFIG_RELOAD,
+    // AddRate pass which added fake rates, build and push.
+    LATENCY_ADD_RATE_PASS,
+    LATENCY_METRIC_NUM
+  };
+  // Name of |metric| in the journal.
+  static const char* LatencyName(LatencyMetric metric);
+  // Latencies of |metric| recorded since the plugin was created, from any
+  // thread.
+  void Latency(LatencyMetric metric, LatencyHistogram::Snapshot& snapshot) const;
 private:
+  // Plugin parameters, see below.
+  struct Config;
+
   // IMTConPluginSink implementations.
   virtual void OnPluginUpdate(const IMTConPlugin* plugin) override;
 
@@ -49,17 +159,154 @@ private:
   // IMTConServerSink implementations.
   virtual void OnConServerUpdate(const IMTConServer* server) override;
 
+  // IMTConFeederSink implementations.
+  virtual void OnFeederAdd(const IMTConFeeder* feeder) override;
+  virtual void OnFeederUpdate(const IMTConFeeder* feeder) override;
+  virtual void OnFeederDelete(const IMTConFeeder* feeder) override;
+  virtual void OnFeederSync(void) override;
+
+  // IMTConSymbolSink implementations.
+  virtual void OnSymbolAdd(const IMTConSymbol* symbol) override;
+  virtual void OnSymbolUpdate(const IMTConSymbol* symbol) override;
+  virtual void OnSymbolDelete(const IMTConSymbol* symbol) override;
+  virtual void OnSymbolSync(void) override;
+
+  // IMTConHolidaySink implementations.
+  virtual void OnHolidayAdd(const IMTConHoliday* holiday) override;
+  virtual void OnHolidayUpdate(const IMTConHoliday* holiday) override;
+  virtual void OnHolidayDelete(const IMTConHoliday* holiday) override;
+  virtual void OnHolidaySync(void) override;
+
   // Read plugin parameters.
   void ReadPluginParameters();
+  // Add symbols list |value| of a "NN.Symbols" parameter to rules of
+  // |config|. |order| is the position of the next rule.
+  static void ReadSymbolRules(Config& config, const wchar_t* value, size_t& order);
+  // Resolve symbol rules of |config| to the watched symbols table, keeping
+  // rates of symbols watched by |current|. Caller holds |sync_mutex_|.
+  void ResolveSymbols(Config& config, const Config* current);
+  // Add |symbol| to watched symbols of |config| if rules select it.
+  // |settings| are its server settings, nullptr to load them. Return true
+  // if it was added.
+  bool WatchSymbol(Config& config, const Config* current,
+                   const wchar_t* symbol, const IMTConSymbol* settings);
+  // Symbols configuration events change the watched symbols of a copy of
+  // the current configuration, parameters are not read again. Symbols
+  // added by |WatchNewSymbol| are seeded one by one, |DropSymbols| removes
+  // the symbols |keep| rejects unless they are given by name, and
+  // |PublishSymbols| publishes the copy. Caller holds |sync_mutex_|.
+  bool WatchNewSymbol(Config& config, const Config& current, const IMTConSymbol* symbol);
+  template<typename KeepT>
+  static size_t DropSymbols(Config& config, KeepT keep);
+  void PublishSymbols(std::unique_ptr<Config> config, RcuPtr<Config>::ReadGuard& current);
+  // Check if rules of |config| select |symbol|, set its fake rate timeout.
+  static bool MatchRules(const Config& config, const wchar_t* symbol, INT64& timeout_msc);
+  // Add price models list |value| of "06.PriceModels" parameter to |config|.
+  static void ReadPriceModels(Config& config, const wchar_t* value);
+  // Price model of |symbol| in |config|.
+  static PriceModel MatchPriceModel(const Config& config, const wchar_t* symbol);
+  // Warn if |model| cannot work with the quote settings of symbol |info|,
+  // fake prices then use |PRICE_JITTER|.
+  static void CheckPriceModel(const RateInfo& info, PriceModel model);
+  // Fake rate timeout of a symbol (milliseconds) in |config|: |timeout_msc|
+  // resolved from rules, or the default one if they give none, less the
+  // processing margin. The symbol |quotes_timeout| (seconds) replaces the
+  // default one if parameters ask for it.
+  static INT64 SymbolTimeout(const Config& config, INT64 timeout_msc, UINT quotes_timeout);
+
+  // Map the rates snapshot file and log how many symbols it holds.
+  void OpenSnapshot();
+  // Restore rates of new symbol |info| from the snapshot if they are at
+  // most |max_age_msc| old. Caller holds |sync_mutex_|.
+  void RestoreRate(RateInfo& info, INT64 max_age_msc);
+  // Seed rates of symbols of |config| not watched by |current| (nullptr
+  // at start) which have none from the last tick of the server, in parallel
+  // chunks. Caller holds |sync_mutex_|.
+  void SeedRates(const Config& config, const Config* current);
+  // Seed rates of |info| from its last tick if it is at most |max_age_msc|
+  // older than |server_time_msc|. Return true if they were seeded.
+  bool SeedRate(RateInfo& info, INT64 server_time_msc, INT64 max_age_msc);
 
   // Read server configuration parameters.
   void ReadServerParameters();
 
+  // Rebuild |main_feeders_| from datafeeds configuration.
+  void UpdateMainFeeders();
+  // Rebuild |main_feeders_| after a configuration event of |feeder|, only
+  // if it is the main feed or the main feed positions no longer hold it.
+  void UpdateMainFeeders(const IMTConFeeder* feeder);
+  // Check if datafeed at position |feeder_pos| is the main feed.
+  bool IsMainFeeder(int feeder_pos) const;
+
+  // Update cached settings of a watched symbol from |symbol| (nullptr:
+  // symbol is deleted), from server configuration, or of all watched
+  // symbols. Caller holds |sync_mutex_|.
+  void UpdateSymbolSpec(RateInfo& info, const IMTConSymbol* symbol);
+  void LoadSymbolSpec(RateInfo& info);
+  void UpdateSymbolSpecs(const Config& config);
+
+  // Reload |holidays_| and, if they have changed, the quote schedules of
+  // watched symbols.
+  void UpdateHolidays();
+  // Read enabled holidays into |holidays_|. Caller holds |sync_mutex_|.
+  void LoadHolidays();
+  // Return the quote schedule of |symbol| from its quote sessions and
+  // holidays, nullptr if it is always open. Caller holds |sync_mutex_|.
+  const QuoteSchedule* BuildSchedule(const IMTConSymbol* symbol);
+
   // Update |RateInfo| of symbols when new tick from main feed came.
   void UpdateRateInfo(const MTTick& tick);
 
   // Generate fake rate when necessary. It's run on a seperate thread.
   void AddRate();
+  // Fake rates of one generator pass. Ticks are built per symbol, their
+  // prices all at once by the batch of their price model.
+  struct FakeRatePass {
+    std::vector<MTTick> ticks;
+    // Symbol of each tick.
+    std::vector<RateInfo*> symbols;
+    // Price model of each tick and its position in the model batch.
+    std::vector<PriceModel> models;
+    std::vector<size_t> positions;
+    // Quote limits of each tick, its prices are fitted into them.
+    std::vector<QuoteLimits> limits;
+    FakePriceBatch prices[PRICE_MODEL_NUM];
+    // Number of ticks built from seeded rates.
+    size_t seeded = 0;
+
+    void Clear() {
+      ticks.clear();
+      symbols.clear();
+      models.clear();
+      positions.clear();
+      limits.clear();
+      for (auto& batch : prices)
+        batch.Clear();
+      seeded = 0;
+    }
+  };
+  // Build fake rates of all due symbols of |wheel| into |pass|, return
+  // false if there is nothing to add. |scheduled_version| and
+  // |scheduled_schedules| are the configuration and |schedules_version_|
+  // the wheel was filled for.
+  bool BuildFakeRates(TimerWheel<std::shared_ptr<RateInfo>>& wheel,
+                      UINT64& scheduled_version,
+                      UINT64& scheduled_schedules,
+                      FakeRatePass& pass);
+  // Add fake rate of symbol |info|, whose rates are |state|, to |pass|.
+  // Its prices are set by |model| once the pass is built. Return false if
+  // the symbol must not get fake rate.
+  bool BuildFakeRate(RateInfo& info, const RateState& state, PriceModel model,
+                     INT64 now, FakeRatePass& pass);
+  // Write a summary of fake rates results to the journal. |accepted| and
+  // |rejected| are totals of the previous summary, updated.
+  void ReportTickStats(UINT64& accepted, UINT64& rejected) const;
+  // Write percentiles of latencies recorded since |previous|, the
+  // histograms of the previous report, to the journal and update it.
+  void ReportLatency(std::array<LatencyHistogram::Snapshot, LATENCY_METRIC_NUM>& previous) const;
+  // Wake the add rate thread up before its next deadline, after a change
+  // of the watched symbols or of their schedules, or to stop it.
+  void WakeAddRate();
   // Start/stop add rate thread.
   void StartAddRateThread();
   void StopAddRateThread();
@@ -72,33 +319,149 @@ private:
   IMTConFeeder* feeder_config_;
   IMTConSymbol* symbol_config_;
   IMTConServer* server_config_;
+  IMTConSymbolSession* session_config_;
+  IMTConHoliday* holiday_config_;
 
-  // Engine which is userd to generate random number.
+  // Engine which is userd to seed the fake price streams of symbols.
+  // Used under |sync_mutex_|.
   std::mt19937 number_engine_;
 
-  // Timeout to add fake rate.
-  int timeout_;
-
-  // Feeder name, where we get rate.
-  std::wstring feeder_name_;
+  // Maximum number of datafeeds tracked by |main_feeders_|.
+  static const int kMaxFeeders = 256;
+  // Bitmap indexed by datafeed position (hook feeder index minus
+  // MT_FEEDER_OFFSET), a bit is set if the datafeed is |feeder_name_|.
+  // Precomputed so that HookTick does not resolve feeder names per tick,
+  // rebuilt on main feed or datafeeds configuration changes.
+  std::array<std::atomic<UINT64>, kMaxFeeders / 64> main_feeders_;
 
   // Feeder switch timeout value of history server.
   int feeder_switch_timeout_;
 
-  // All symbols used in Nonstop Rate plugin.
+  // Entry of "NN.Symbols" parameters: symbol name or mask, "!" prefix
+  // excludes the symbols it matches, "=timeout" suffix overrides the
+  // timeout for them. Ex: "EUR*=500ms,XAU*=5,!*.mini".
+  // Symbols given by name are looked up, masks and exclusions are matched.
+  struct SymbolRule {
+    SymbolMask mask;
+    bool exclude = false;
+    // Fake rate timeout (milliseconds), 0 to use the plugin timeout.
+    INT64 timeout_msc = 0;
+    // Position in parameters, later rules override earlier ones.
+    size_t order = 0;
+  };
+  struct NamedRule {
+    INT64 timeout_msc = 0;
+    size_t order = 0;
+  };
+
+  // Entry of "06.PriceModels" parameter: symbol name or mask and the model
+  // of its fake prices. Ex: "XAU*=walk,EURUSD=revert".
+  struct PriceModelRule {
+    SymbolMask mask;
+    PriceModel model = PRICE_JITTER;
+  };
+
+  struct WatchedSymbol {
+    // Rate information is shared by successive configurations, so symbols
+    // which are kept on a parameters change keep their rates.
+    std::shared_ptr<RateInfo> info;
+    // Fake rate timeout (milliseconds), resolved from rules, 0 to use the
+    // default one.
+    INT64 timeout_msc = 0;
+    // Model of fake prices, resolved from price model rules.
+    PriceModel model = PRICE_JITTER;
+  };
+
+  // All symbols used in Nonstop Rate plugin, resolved from symbol rules
+  // when parameters or symbols change, so hooks never evaluate masks.
   // Also store it's information to create fake rate.
-  using SymbolInformation = std::map<std::wstring, RateInfo>;
-  SymbolInformation symbols_;
+  using SymbolInformation = SymbolTable<WatchedSymbol>;
+
+  // Plugin parameters. Never changed once published, a parameters change
+  // builds a new one aside and replaces it as a whole.
+  struct Config {
+    // Incremented on every parameters change.
+    UINT64 version = 0;
+    // Timeout to add fake rate (milliseconds), 0 if not set: symbols then
+    // use the default one.
+    INT64 timeout_msc = 0;
+    // Symbols without a timeout use their quotes timeout, if they have
+    // one, instead of the default one.
+    bool use_quotes_timeout = false;
+    // Time taken to process fake rates (milliseconds), subtracted from the
+    // timeouts of all symbols.
+    INT64 processing_margin_msc = 0;
+    // Feeder name, where we get rate.
+    std::wstring feeder_name;
+    // Lowest severity written to log.
+    Severity log_level = static_cast<Severity>(LOG_MIN_SEVERITY);
+    // Oldest snapshot rate or last tick seeded for a new symbol
+    // (milliseconds), 0 disables seeding.
+    INT64 snapshot_max_age_msc = 0;
+    // Symbol masks and exclusions in parameters order.
+    std::vector<SymbolRule> rules;
+    // Symbols given by name.
+    SymbolTable<NamedRule> named_rules;
+    // Some rules have wildcards, so symbols configuration changes may
+    // change watched symbols.
+    bool has_masks = false;
+    // Price models in parameters order, the last matching one applies,
+    // |PRICE_JITTER| if none does.
+    std::vector<PriceModelRule> model_rules;
+    SymbolInformation symbols;
+  };
+  // Current configuration. Hooks read it without locking, readers still
+  // holding the previous one delay its deletion, not the swap.
+  RcuPtr<Config> config_;
+
+  // Last real rates of watched symbols, kept across restarts so fake rates
+  // cover an outage right after the plugin starts.
+  RateSnapshot snapshot_;
+
+  // Enabled holiday of the server configuration and the symbol path masks
+  // it applies to.
+  struct HolidayRule {
+    QuoteSchedule::Holiday holiday;
+    std::vector<SymbolMask> symbols;
+
+    bool operator==(const HolidayRule& other) const {
+      if (!(holiday == other.holiday) || symbols.size() != other.symbols.size())
+        return false;
+      for (size_t i = 0; i < symbols.size(); i++) {
+        if (symbols[i].Pattern() != other.symbols[i].Pattern())
+          return false;
+      }
+      return true;
+    }
+  };
+  std::vector<HolidayRule> holidays_;
+
+  // Distinct quote schedules of symbols. They are kept until the plugin
+  // stops, so the AddRate thread uses them without reference counting;
+  // symbols share a few schedules and they rarely change.
+  std::vector<std::unique_ptr<const QuoteSchedule>> schedules_;
+
+  // Incremented when the schedule or the quotes timeout of a watched
+  // symbol changes, the AddRate thread then schedules all symbols again.
+  std::atomic<UINT64> schedules_version_;
+
+  // Latencies of |LatencyMetric| code paths.
+  std::array<LatencyHistogram, LATENCY_METRIC_NUM> latency_;
 
   // Seperate |AddRate| behavior to another thread.
   std::thread add_rate_thread_;
   // Used to stop add rate thread.
   bool stop_thread_;
+  // Add rate thread sleeps on |wake_| until its next deadline.
+  std::mutex wake_mutex_;
+  std::condition_variable wake_cv_;
+  bool wake_;
 
   // Mutex to protect behavior of this class.
   // Change to use std::mutex instead of CRITICAL_SECTION because of 
   // performance reason. Since VC140, std::muxtex is faster than CRITICAL_SECTION.
   std::mutex sync_mutex_;
-  std::mutex add_rate_mutex_;
+  // Serialize |main_feeders_| rebuilds, also protect |feeder_config_|.
+  std::mutex feeder_mutex_;
 };
 
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <string_view>
+
+#include "common.h"
+
+// Tokenizer of plugin parameters. Names and values are read in place from
+// the LPCWSTR buffers of IMTConParam in a single pass, nothing is copied
+// or allocated: tokens are views of the buffers, which must outlive them.
+// Ex:
+//    if (param::Classify(param->Name()) == param::PARAM_SYMBOLS) {
+//      for (param::Token item : common::SplitView(param->Value(), L','))
+//        param::ParseSymbolRule(item) ...
+//    }
+namespace param {
+
+using Token = std::wstring_view;
+
+inline bool IsDigit(wchar_t c) { return c >= L'0' && c <= L'9'; }
+
+enum ParamType {
+  PARAM_UNKNOWN,
+  PARAM_TIMEOUT,
+  PARAM_FEEDER,
+  PARAM_LOG_LEVEL,
+  PARAM_SNAPSHOT_MAX_AGE,
+  PARAM_PRICE_MODELS,
+  PARAM_PROCESSING_MARGIN,
+  PARAM_USE_QUOTES_TIMEOUT,
+  // "NN.Symbols", there may be several because maximum length of parameter
+  // textbox in MT5 is 260 characters.
+  PARAM_SYMBOLS,
+};
+
+// Type of parameter |name|.
+inline ParamType Classify(const wchar_t* name) {
+  Token token = common::Trim(name);
+  if (token == TIMEOUT_PARAM_NAME || token == LEGACY_TIMEOUT_PARAM_NAME)
+    return PARAM_TIMEOUT;
+  if (token == FEEDER_PARAM_NAME)
+    return PARAM_FEEDER;
+  if (token == LOG_LEVEL_PARAM_NAME)
+    return PARAM_LOG_LEVEL;
+  if (token == SNAPSHOT_MAX_AGE_PARAM_NAME)
+    return PARAM_SNAPSHOT_MAX_AGE;
+  if (token == PRICE_MODELS_PARAM_NAME)
+    return PARAM_PRICE_MODELS;
+  if (token == PROCESSING_MARGIN_PARAM_NAME)
+    return PARAM_PROCESSING_MARGIN;
+  if (token == USE_QUOTES_TIMEOUT_PARAM_NAME)
+    return PARAM_USE_QUOTES_TIMEOUT;
+  if (token.size() > 2 && IsDigit(token[0]) && IsDigit(token[1]) &&
+      token.substr(2) == L".Symbols")
+    return PARAM_SYMBOLS;
+  return PARAM_UNKNOWN;
+}
+
+// Entry of a symbols list: "[!]name[=timeout]".
+struct SymbolRuleToken {
+  Token name;
+  bool exclude = false;
+  // Empty if there is no timeout.
+  Token timeout;
+  bool has_timeout = false;
+};
+
+// Split symbols list |item| into its parts.
+inline SymbolRuleToken ParseSymbolRule(Token item) {
+  SymbolRuleToken rule;
+  item = common::Trim(item);
+  if (!item.empty() && item[0] == L'!') {
+    rule.exclude = true;
+    item.remove_prefix(1);
+  }
+  size_t separator = item.find(L'=');
+  if (separator != Token::npos) {
+    rule.has_timeout = true;
+    rule.timeout = common::Trim(item.substr(separator + 1));
+  }
+  rule.name = common::Trim(item.substr(0, separator));
+  return rule;
+}
+
+// Parse duration |text| to milliseconds: "30" and "1.5" are seconds,
+// "500ms" milliseconds, "2s" seconds. Return false if it is not a valid
+// duration.
+inline bool ParseDuration(Token text, INT64& msc) {
+  text = common::Trim(text);
+  size_t pos = 0;
+  double value = 0;
+  bool digits = false;
+  for (; pos < text.size() && IsDigit(text[pos]); pos++) {
+    value = value * 10 + (text[pos] - L'0');
+    digits = true;
+  }
+  if (pos < text.size() && text[pos] == L'.') {
+    double scale = 0.1;
+    for (pos++; pos < text.size() && IsDigit(text[pos]); pos++, scale /= 10) {
+      value += (text[pos] - L'0') * scale;
+      digits = true;
+    }
+  }
+  if (!digits)
+    return false;
+
+  Token unit = common::Trim(text.substr(pos));
+  if (unit == L"ms")
+    msc = std::llround(value);
+  else if (unit.empty() || unit == L"s")
+    msc = std::llround(value * 1000);
+  else
+    return false;
+  return true;
+}
+
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+// Quote sessions of a symbol: a bitmap of the minutes of a week in which
+// quotes are accepted, and the holidays which close the symbol on given
+// dates. Built when symbols or holidays configuration changes, so checking
+// a symbol is a bit lookup and finding its next session scans words.
+// Times are server time in seconds since 01/01/1970, as |TimeCurrent|.
+// Ex:
+//    QuoteSchedule schedule;
+//    for (UINT wday = 1; wday <= 5; wday++)
+//      schedule.AddSession(wday, 0, 1440);  // Monday to Friday.
+//    if (!schedule.IsOpen(now)) wake = schedule.NextOpen(now);
+class QuoteSchedule {
+public:
+  static const UINT kMinutesInDay = 24 * 60;
+  static const UINT kDaysInWeek = 7;
+  static const UINT kMinutesInWeek = kDaysInWeek * kMinutesInDay;
+  // Longest closed period searched by |NextOpen|: a week, and as many
+  // holidays.
+  static const UINT kLookAheadDays = 2 * kDaysInWeek;
+
+  // Holiday of |IMTConHoliday|: on its date the symbol is only open in
+  // its sessions within [work_from, work_to) minutes.
+  struct Holiday {
+    // 0: every year.
+    UINT year = 0;
+    UINT month = 0;
+    UINT day = 0;
+    UINT work_from = 0;
+    UINT work_to = 0;
+
+    bool operator==(const Holiday& other) const {
+      return year == other.year && month == other.month && day == other.day &&
+             work_from == other.work_from && work_to == other.work_to;
+    }
+  };
+
+  QuoteSchedule() : minutes_(), open_minutes_(0) {}
+
+  // Open quotes on |wday| (0: Sunday) from |open| to |close| minutes.
+  void AddSession(UINT wday, UINT open, UINT close) {
+    if (wday >= kDaysInWeek)
+      return;
+    close = std::min(close, kMinutesInDay);
+    UINT last = wday * kMinutesInDay + close;
+    for (UINT bit = wday * kMinutesInDay + open; bit < last;) {
+      UINT count = std::min(64 - bit % 64, last - bit);
+      UINT64 mask = count == 64 ? ~0ULL : (1ULL << count) - 1;
+      mask <<= bit % 64;
+      // Sessions may overlap, only count minutes newly opened.
+      open_minutes_ += PopCount(mask & ~minutes_[bit / 64]);
+      minutes_[bit / 64] |= mask;
+      bit += count;
+    }
+  }
+
+  void AddHoliday(const Holiday& holiday) { holidays_.push_back(holiday); }
+
+  // Number of open minutes in a week, holidays aside.
+  UINT OpenMinutes() const { return open_minutes_; }
+  // Open all the time, nothing to check.
+  bool AlwaysOpen() const { return open_minutes_ == kMinutesInWeek && holidays_.empty(); }
+
+  bool IsOpen(INT64 time) const { return NextOpen(time, 0) == time; }
+
+  // Return the first time from |time| on when quotes are open, |time| if
+  // they are open now, -1 if they do not open within |days| days.
+  INT64 NextOpen(INT64 time, UINT days = kLookAheadDays) const {
+    if (time < 0 || open_minutes_ == 0)
+      return -1;
+    INT64 day = time / kSecondsInDay;
+    UINT from = static_cast<UINT>(time % kSecondsInDay / 60);
+    for (UINT i = 0; i <= days; i++, day++, from = 0) {
+      INT64 minute = FirstOpen(day, from);
+      if (minute >= 0) {
+        INT64 open = day * kSecondsInDay + minute * 60;
+        return std::max(open, time);
+      }
+    }
+    return -1;
+  }
+
+  bool operator==(const QuoteSchedule& other) const {
+    return minutes_ == other.minutes_ && holidays_ == other.holidays_;
+  }
+
+private:
+  static const INT64 kSecondsInDay = 24 * 60 * 60;
+
+  // First open minute of |day| (days since 01/01/1970) from minute |from|,
+  // -1 if it is closed for the rest of the day.
+  INT64 FirstOpen(INT64 day, UINT from) const {
+    // 01/01/1970 is a Thursday.
+    UINT wday = static_cast<UINT>((day + 4) % kDaysInWeek);
+    UINT to = kMinutesInDay;
+    if (!holidays_.empty()) {
+      UINT year, month, mday;
+      CivilDate(day, year, month, mday);
+      for (auto& holiday : holidays_) {
+        if ((holiday.year == 0 || holiday.year == year) &&
+            holiday.month == month && holiday.day == mday) {
+          from = std::max(from, holiday.work_from);
+          to = std::min(to, holiday.work_to);
+          break;
+        }
+      }
+    }
+    for (UINT minute = from; minute < to;) {
+      UINT bit = wday * kMinutesInDay + minute;
+      UINT64 word = minutes_[bit / 64] >> (bit % 64);
+      if (word & 1)
+        return minute;
+      // Skip the closed rest of the word at once.
+      UINT skip = word ? CountTrailingZeros(word) : 64 - bit % 64;
+      minute += skip;
+    }
+    return -1;
+  }
+
+  static UINT PopCount(UINT64 word) {
+    return static_cast<UINT>(std::bitset<64>(word).count());
+  }
+
+  static UINT CountTrailingZeros(UINT64 word) {
+    UINT count = 0;
+    while (!(word & 1)) {
+      word >>= 1;
+      count++;
+    }
+    return count;
+  }
+
+  // Gregorian date of |day| days since 01/01/1970.
+  static void CivilDate(INT64 day, UINT& year, UINT& month, UINT& mday) {
+    day += 719468;
+    INT64 era = day / 146097;
+    UINT doe = static_cast<UINT>(day - era * 146097);
+    UINT yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    UINT doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    UINT mp = (5 * doy + 2) / 153;
+    mday = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = static_cast<UINT>(yoe + era * 400 + (month <= 2));
+  }
+
+  // Bit |wday * kMinutesInDay + minute| is set if quotes are open.
+  std::array<UINT64, (kMinutesInWeek + 63) / 64> minutes_;
+  UINT open_minutes_;
+  std::vector<Holiday> holidays_;
+};
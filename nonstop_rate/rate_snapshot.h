@@ -0,0 +1,315 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#ifndef _WIN32
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "symbol_table.h"
+
+// Last real rates of symbols kept in a memory-mapped file, so that they
+// survive a plugin or server restart. The file has a fixed layout: a
+// header and one slot per symbol. Slots are written in place by the tick
+// hooks, there is nothing to serialize; the operating system writes dirty
+// pages back even if the process dies. Each slot has a sequence counter as
+// |SeqLock|, a slot found odd when the file is opened was being written
+// when the process stopped and is dropped.
+// Slots are assigned to symbols by |Acquire| and never freed, the file
+// grows when it is opened with a larger capacity.
+// Ex:
+//    RateSnapshot snapshot;
+//    snapshot.Open(L"NonstopRate.snapshot", 16384);
+//    RateSnapshot::Slot* slot = snapshot.Acquire(L"EURUSD");
+//    RateSnapshot::Store(slot, RateSnapshot::Rate{ bid, ask, time_msc });  // Tick thread.
+//    if (RateSnapshot::Load(slot, rate)) ...
+class RateSnapshot {
+public:
+  // Maximum symbol length, including terminating zero, as MTTick::symbol.
+  static const size_t kSymbolSize = 32;
+
+  struct Rate {
+    double bid = 0;
+    double ask = 0;
+    // Time of the rate (milliseconds), as stamped by the feed.
+    INT64 time_msc = 0;
+  };
+
+  struct Slot {
+    // Even when the rate is stable, odd while it is written.
+    std::atomic<uint32_t> sequence;
+    uint32_t reserved;
+    std::atomic<uint64_t> bid;
+    std::atomic<uint64_t> ask;
+    std::atomic<int64_t> time_msc;
+    wchar_t symbol[kSymbolSize];
+  };
+
+  RateSnapshot() : header_(nullptr), size_(0) {
+#ifdef _WIN32
+    file_ = INVALID_HANDLE_VALUE;
+    mapping_ = NULL;
+#else
+    file_ = -1;
+#endif
+  }
+  ~RateSnapshot() { Close(); }
+  RateSnapshot(const RateSnapshot&) = delete;
+  RateSnapshot& operator=(const RateSnapshot&) = delete;
+
+  // Map file |path| with room for at least |capacity| symbols, create it
+  // if it does not exist or is not a snapshot. Return false on failure.
+  bool Open(const std::wstring& path, uint32_t capacity) {
+    Close();
+    uint64_t file_size = 0;
+    if (!OpenFile(path, file_size))
+      return false;
+
+    // Keep a larger existing file, rates of all its symbols are reloaded.
+    Header existing = {};
+    if (file_size >= sizeof(Header) && !ReadHeader(existing))
+      existing = Header();
+    bool valid = IsValid(existing, file_size);
+    if (valid && existing.capacity > capacity)
+      capacity = existing.capacity;
+
+    if (!Map(FileSize(capacity))) {
+      Close();
+      return false;
+    }
+    if (!valid) {
+      std::memset(static_cast<void*>(header_), 0, static_cast<size_t>(size_));
+      header_->magic = kMagic;
+      header_->version = kVersion;
+      header_->slot_size = sizeof(Slot);
+      header_->used = 0;
+    }
+    header_->capacity = capacity;
+
+    // Index the symbols of the file.
+    index_.Clear();
+    index_.Reserve(header_->used);
+    for (uint32_t i = 0; i < header_->used; i++) {
+      Slot& slot = slots()[i];
+      slot.symbol[_countof(slot.symbol) - 1] = L'\0';
+      if (slot.sequence.load(std::memory_order_relaxed) & 1)
+        Reset(slot);
+      index_.Insert(slot.symbol) = &slot;
+    }
+    return true;
+  }
+
+  void Close() {
+#ifdef _WIN32
+    if (header_) UnmapViewOfFile(header_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+    mapping_ = NULL;
+    file_ = INVALID_HANDLE_VALUE;
+#else
+    if (header_) munmap(header_, static_cast<size_t>(size_));
+    if (file_ >= 0) close(file_);
+    file_ = -1;
+#endif
+    header_ = nullptr;
+    size_ = 0;
+    index_.Clear();
+  }
+
+  bool IsOpen() const { return header_ != nullptr; }
+  // Number of symbols in the snapshot.
+  uint32_t Size() const { return header_ ? header_->used : 0; }
+  uint32_t Capacity() const { return header_ ? header_->capacity : 0; }
+
+  // Return the slot of |symbol|, assign it a free one if it has none.
+  // Return nullptr if the snapshot is not open or full.
+  // Not thread-safe, slots are acquired under the configuration lock.
+  Slot* Acquire(const wchar_t* symbol) {
+    if (!header_)
+      return nullptr;
+    if (Slot** slot = index_.Find(symbol))
+      return *slot;
+    if (header_->used >= header_->capacity)
+      return nullptr;
+
+    Slot& slot = slots()[header_->used];
+    Reset(slot);
+    std::wcsncpy(slot.symbol, symbol, _countof(slot.symbol) - 1);
+    slot.symbol[_countof(slot.symbol) - 1] = L'\0';
+    // The slot is counted once its symbol is written.
+    header_->used++;
+    index_.Insert(symbol) = &slot;
+    return &slot;
+  }
+
+  // Write |rate| to |slot|.
+  static void Store(Slot* slot, const Rate& rate) {
+    uint32_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    for (;;) {
+      if (sequence & 1) {
+        std::this_thread::yield();
+        sequence = slot->sequence.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (slot->sequence.compare_exchange_weak(sequence, sequence + 1,
+                                               std::memory_order_acquire,
+                                               std::memory_order_relaxed))
+        break;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->bid.store(Bits(rate.bid), std::memory_order_relaxed);
+    slot->ask.store(Bits(rate.ask), std::memory_order_relaxed);
+    slot->time_msc.store(rate.time_msc, std::memory_order_relaxed);
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+  }
+
+  // Read |rate| of |slot|, return false if no rate was stored in it.
+  static bool Load(const Slot* slot, Rate& rate) {
+    for (;;) {
+      uint32_t before = slot->sequence.load(std::memory_order_acquire);
+      if (before & 1) {
+        std::this_thread::yield();
+        continue;
+      }
+      rate.bid = Double(slot->bid.load(std::memory_order_relaxed));
+      rate.ask = Double(slot->ask.load(std::memory_order_relaxed));
+      rate.time_msc = slot->time_msc.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot->sequence.load(std::memory_order_relaxed) == before)
+        return before != 0;
+    }
+  }
+
+private:
+  static const uint32_t kMagic = 0x534E524E;  // NRNS
+  static const uint32_t kVersion = 1;
+
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_size;
+    uint32_t capacity;
+    // Slots assigned to symbols, from the first one.
+    uint32_t used;
+    uint32_t reserved[11];
+  };
+  static_assert(sizeof(Header) % alignof(Slot) == 0, "Slots must be aligned");
+
+  static uint64_t FileSize(uint32_t capacity) {
+    return sizeof(Header) + static_cast<uint64_t>(capacity) * sizeof(Slot);
+  }
+
+  static bool IsValid(const Header& header, uint64_t file_size) {
+    return header.magic == kMagic && header.version == kVersion &&
+           header.slot_size == sizeof(Slot) && header.used <= header.capacity &&
+           FileSize(header.capacity) <= file_size;
+  }
+
+  static void Reset(Slot& slot) {
+    slot.sequence.store(0, std::memory_order_relaxed);
+    slot.bid.store(0, std::memory_order_relaxed);
+    slot.ask.store(0, std::memory_order_relaxed);
+    slot.time_msc.store(0, std::memory_order_relaxed);
+  }
+
+  static uint64_t Bits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+  static double Double(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  Slot* slots() const {
+    return reinterpret_cast<Slot*>(reinterpret_cast<char*>(header_) + sizeof(Header));
+  }
+
+#ifdef _WIN32
+  bool OpenFile(const std::wstring& path, uint64_t& file_size) {
+    file_ = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                        NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER size;
+    if (file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_, &size)) {
+      Close();
+      return false;
+    }
+    file_size = static_cast<uint64_t>(size.QuadPart);
+    return true;
+  }
+
+  bool ReadHeader(Header& header) {
+    DWORD read = 0;
+    return ReadFile(file_, &header, sizeof(header), &read, NULL) && read == sizeof(header);
+  }
+
+  // The mapping extends the file to |size|.
+  bool Map(uint64_t size) {
+    mapping_ = CreateFileMappingW(file_, NULL, PAGE_READWRITE,
+                                  static_cast<DWORD>(size >> 32),
+                                  static_cast<DWORD>(size), NULL);
+    if (!mapping_)
+      return false;
+    header_ = static_cast<Header*>(MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0,
+                                                 static_cast<SIZE_T>(size)));
+    size_ = size;
+    return header_ != nullptr;
+  }
+
+  HANDLE file_;
+  HANDLE mapping_;
+#else
+  // Linux host build: the path is built with Windows separators.
+  bool OpenFile(const std::wstring& path, uint64_t& file_size) {
+    std::wstring native = path;
+    std::replace(native.begin(), native.end(), L'\\', L'/');
+    std::filesystem::path file_path = std::filesystem::path(native).lexically_normal();
+    std::error_code error;
+    std::filesystem::create_directories(file_path.parent_path(), error);
+    file_ = open(file_path.c_str(), O_RDWR | O_CREAT, 0644);
+    struct stat status;
+    if (file_ < 0 || fstat(file_, &status) != 0) {
+      Close();
+      return false;
+    }
+    file_size = static_cast<uint64_t>(status.st_size);
+    return true;
+  }
+
+  bool ReadHeader(Header& header) {
+    return pread(file_, &header, sizeof(header), 0) == sizeof(header);
+  }
+
+  bool Map(uint64_t size) {
+    struct stat status;
+    if (fstat(file_, &status) != 0 ||
+        (static_cast<uint64_t>(status.st_size) < size &&
+         ftruncate(file_, static_cast<off_t>(size)) != 0))
+      return false;
+    void* address = mmap(nullptr, static_cast<size_t>(size), PROT_READ | PROT_WRITE,
+                         MAP_SHARED, file_, 0);
+    if (address == MAP_FAILED)
+      return false;
+    header_ = static_cast<Header*>(address);
+    size_ = size;
+    return true;
+  }
+
+  int file_;
+#endif
+
+  Header* header_;
+  uint64_t size_;
+  // Slot of each symbol of the file.
+  SymbolTable<Slot*> index_;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Pointer to an immutable object which is replaced as a whole (read-copy-
+// update). Readers never block: they announce themselves in a per-thread
+// counter shard and load the current pointer. |Publish| swaps in a new
+// object, waits until every reader which could still see the old one has
+// left, then deletes it. Only writers wait, so it fits data which is read
+// on every tick and changed by an administrator now and then.
+// Readers may nest, a thread holding a |ReadGuard| must not |Publish|.
+// Ex:
+//    RcuPtr<Config> config;
+//    config.Publish(std::unique_ptr<Config>(new Config(...)));  // Writer.
+//    auto current = config.Read();                              // Reader.
+//    if (current) Use(current->timeout);
+template<typename T>
+class RcuPtr {
+public:
+  // Keeps the object loaded by |Read| alive until destroyed.
+  class ReadGuard {
+  public:
+    ReadGuard(ReadGuard&& other) : counter_(other.counter_), value_(other.value_) {
+      other.counter_ = nullptr;
+    }
+    ~ReadGuard() { Reset(); }
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+
+    const T* get() const { return value_; }
+    const T* operator->() const { return value_; }
+    const T& operator*() const { return *value_; }
+    explicit operator bool() const { return value_ != nullptr; }
+
+    // Leave the read side before the guard goes out of scope.
+    void Reset() {
+      if (counter_)
+        counter_->fetch_sub(1, std::memory_order_release);
+      counter_ = nullptr;
+      value_ = nullptr;
+    }
+
+  private:
+    friend class RcuPtr;
+    ReadGuard(std::atomic<int64_t>* counter, const T* value)
+        : counter_(counter), value_(value) {}
+
+    std::atomic<int64_t>* counter_;
+    const T* value_;
+  };
+
+  RcuPtr() : epoch_(0), value_(nullptr) {}
+  ~RcuPtr() { delete value_.load(); }
+  RcuPtr(const RcuPtr&) = delete;
+  RcuPtr& operator=(const RcuPtr&) = delete;
+
+  // Return current object, may be empty.
+  ReadGuard Read() const {
+    std::atomic<int64_t>* counter =
+        &counters_[epoch_.load() & 1][ThreadShard()].readers;
+    counter->fetch_add(1);
+    return ReadGuard(counter, value_.load());
+  }
+
+  // Replace current object by |value| (may be empty) and reclaim the old one
+  // once no reader holds it.
+  void Publish(std::unique_ptr<T> value) {
+    std::lock_guard<std::mutex> lock(publish_mutex_);
+    T* old_value = value_.exchange(value.release());
+
+    // Readers which loaded |old_value| are counted in one of the two
+    // counter sets. New readers are moved to the other set before waiting
+    // for one, so both sets drain even under a constant flow of readers.
+    for (int i = 0; i < 2; i++) {
+      unsigned epoch = epoch_.fetch_add(1) & 1;
+      while (Readers(epoch) != 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    delete old_value;
+  }
+
+private:
+  // Number of reader counters per set, spreads hooks of different threads
+  // over different cache lines.
+  static const size_t kShards = 16;
+
+  struct alignas(64) Counter {
+    std::atomic<int64_t> readers{ 0 };
+  };
+
+  static size_t ThreadShard() {
+    static thread_local size_t shard =
+        std::hash<std::thread::id>()(std::this_thread::get_id()) % kShards;
+    return shard;
+  }
+
+  int64_t Readers(unsigned epoch) const {
+    int64_t readers = 0;
+    for (const auto& counter : counters_[epoch])
+      readers += counter.readers.load();
+    return readers;
+  }
+
+  mutable Counter counters_[2][kShards];
+  std::atomic<unsigned> epoch_;
+  std::atomic<T*> value_;
+  // Serialize writers.
+  std::mutex publish_mutex_;
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+// Sequence lock around a small trivially copyable value.
+// Readers never block writers: |Load| copies the value and retries if a
+// write happened meanwhile. Writers of the same value are serialized by
+// the sequence counter itself, writers of different values never touch a
+// shared cache line.
+// The value is kept in atomic words, so concurrent copies are well defined.
+// Ex:
+//    SeqLock<Rate> rate;
+//    rate.Store(Rate{ bid, ask });                      // Tick thread.
+//    rate.Update([&](Rate& value) { value.bid = bid; });  // Tick thread.
+//    Rate snapshot = rate.Load();                        // Any thread.
+template<typename T>
+class SeqLock {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SeqLock value must be trivially copyable");
+public:
+  explicit SeqLock(const T& value = T()) : sequence_(0) {
+    Write(value);
+  }
+
+  // Copies are only used while building containers, they are not atomic
+  // with respect to writers of |other|.
+  SeqLock(const SeqLock& other) : sequence_(0) {
+    Write(other.Load());
+  }
+  SeqLock& operator=(const SeqLock& other) {
+    Store(other.Load());
+    return *this;
+  }
+
+  // Return a consistent copy of the value.
+  T Load() const {
+    uint64_t words[kWords];
+    for (;;) {
+      uint32_t before = sequence_.load(std::memory_order_acquire);
+      if (before & 1) {
+        std::this_thread::yield();
+        continue;
+      }
+      for (size_t i = 0; i < kWords; i++)
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == before)
+        break;
+    }
+
+    T value;
+    std::memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+  // Replace the value.
+  void Store(const T& value) {
+    uint32_t sequence = Lock();
+    Write(value);
+    Unlock(sequence);
+  }
+
+  // Modify the value in place with |update(T&)|, as one write.
+  template<typename UpdateT>
+  void Update(UpdateT update) {
+    uint32_t sequence = Lock();
+    T value = Read();
+    update(value);
+    Write(value);
+    Unlock(sequence);
+  }
+
+private:
+  static const size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  // Make the sequence odd, return its previous (even) value.
+  uint32_t Lock() {
+    uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    for (;;) {
+      if (sequence & 1) {
+        std::this_thread::yield();
+        sequence = sequence_.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (sequence_.compare_exchange_weak(sequence, sequence + 1,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed))
+        break;
+    }
+    // Readers which see new words must also see the odd sequence.
+    std::atomic_thread_fence(std::memory_order_release);
+    return sequence;
+  }
+
+  void Unlock(uint32_t sequence) {
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  // Copy the value in/out of |words_|, the caller holds the write lock.
+  T Read() const {
+    uint64_t words[kWords];
+    for (size_t i = 0; i < kWords; i++)
+      words[i] = words_[i].load(std::memory_order_relaxed);
+    T value;
+    std::memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+  void Write(const T& value) {
+    uint64_t words[kWords] = {};
+    std::memcpy(words, &value, sizeof(T));
+    for (size_t i = 0; i < kWords; i++)
+      words_[i].store(words[i], std::memory_order_relaxed);
+  }
+
+  // Even when the value is stable, odd while a write is in progress.
+  std::atomic<uint32_t> sequence_;
+  std::atomic<uint64_t> words_[kWords];
+};
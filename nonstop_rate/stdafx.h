@@ -16,6 +16,8 @@
 // TODO: reference additional headers your program requires here
 #include "MT5APIServer.h"
 
-// This macro used to hide logs in development phase.
-// We can change it from |Preprocessor| setting.
+// This macro used to show development (DEBUG) logs, it is defined for
+// Debug builds. We can change it from |Preprocessor| setting.
+#if defined(_DEBUG) && !defined(_DEV)
 #define _DEV
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cwctype>
+#include <string>
+#include <string_view>
+
+// Symbol name mask, as in MT5 group symbol settings: '*' matches any
+// sequence of characters, '?' any single character, the case is ignored.
+// The pattern is upper-cased once when the mask is built, so matching only
+// converts the symbol name.
+// Ex:
+//    SymbolMask mask(L"EUR*");
+//    if (mask.Match(L"EURUSD")) ...
+class SymbolMask {
+public:
+  SymbolMask() : wildcards_(false) {}
+
+  explicit SymbolMask(std::wstring_view pattern) : wildcards_(false) {
+    pattern_.reserve(pattern.size());
+    for (wchar_t c : pattern) {
+      // Successive stars match the same as one.
+      if (c == L'*' && !pattern_.empty() && pattern_.back() == L'*')
+        continue;
+      if (c == L'*' || c == L'?')
+        wildcards_ = true;
+      pattern_.push_back(static_cast<wchar_t>(std::towupper(c)));
+    }
+  }
+
+  // Upper-cased pattern.
+  const std::wstring& Pattern() const { return pattern_; }
+
+  // Pattern has wildcards, otherwise it matches one symbol name only.
+  bool HasWildcards() const { return wildcards_; }
+
+  // Return true if |symbol| (zero terminated) matches the mask.
+  bool Match(const wchar_t* symbol) const {
+    const wchar_t* pattern = pattern_.c_str();
+    // Position after the last star and the symbol character it was
+    // matched against, to backtrack when the rest does not match.
+    const wchar_t* star = nullptr;
+    const wchar_t* star_symbol = nullptr;
+
+    while (*symbol) {
+      wchar_t c = static_cast<wchar_t>(std::towupper(*symbol));
+      if (*pattern == L'*') {
+        star = ++pattern;
+        star_symbol = symbol;
+      } else if (*pattern == L'?' || *pattern == c) {
+        pattern++;
+        symbol++;
+      } else if (star) {
+        // Let the last star take one more character.
+        pattern = star;
+        symbol = ++star_symbol;
+      } else {
+        return false;
+      }
+    }
+    while (*pattern == L'*')
+      pattern++;
+    return *pattern == 0;
+  }
+
+private:
+  std::wstring pattern_;
+  bool wildcards_;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cwchar>
+#include <vector>
+
+// Hash table of per-symbol data keyed directly on MT5 symbol names.
+// Names are kept in fixed buffers of the same size as MTTick::symbol, so
+// a lookup hashes and compares the caller's buffer without allocating.
+// Entries are stored contiguously in insertion order; the open addressing
+// index (linear probing) only keeps entry positions and hashes.
+// Entries cannot be removed one by one, clear and refill the table instead.
+// Ex:
+//    SymbolTable<RateInfo> symbols;
+//    symbols.Insert(L"EURUSD").last_bid = 1.1;
+//    if (RateInfo* info = symbols.Find(tick.symbol)) ...
+template<typename ValueT>
+class SymbolTable {
+public:
+  // Maximum symbol length, including terminating zero.
+  static const size_t kSymbolSize = 32;
+
+  struct Entry {
+    wchar_t symbol[kSymbolSize];
+    ValueT value;
+  };
+
+  using iterator = typename std::vector<Entry>::iterator;
+  using const_iterator = typename std::vector<Entry>::const_iterator;
+
+  SymbolTable() : mask_(0) {}
+
+  // Return value of |symbol|, or nullptr if |symbol| is not in the table.
+  ValueT* Find(const wchar_t* symbol) {
+    int32_t index = FindIndex(symbol, Hash(symbol));
+    return index < 0 ? nullptr : &entries_[index].value;
+  }
+  const ValueT* Find(const wchar_t* symbol) const {
+    int32_t index = FindIndex(symbol, Hash(symbol));
+    return index < 0 ? nullptr : &entries_[index].value;
+  }
+
+  // Return value of |symbol|, insert a default value if it does not exist.
+  // Names longer than kSymbolSize - 1 characters are truncated.
+  // Inserting may invalidate pointers returned by |Find|.
+  ValueT& Insert(const wchar_t* symbol) {
+    uint32_t hash = Hash(symbol);
+    int32_t index = FindIndex(symbol, hash);
+    if (index >= 0)
+      return entries_[index].value;
+
+    if ((entries_.size() + 1) * 2 > slots_.size())
+      Rehash(std::max<size_t>(16, slots_.size() * 2));
+
+    Entry entry = {};
+    std::wcsncpy(entry.symbol, symbol, kSymbolSize - 1);
+    entries_.push_back(entry);
+    Place(hash, static_cast<int32_t>(entries_.size() - 1));
+    return entries_.back().value;
+  }
+
+  // Make room for |count| entries, so that filling the table up to it does
+  // not reallocate or rehash.
+  void Reserve(size_t count) {
+    entries_.reserve(count);
+    size_t capacity = 16;
+    while (capacity < count * 2)
+      capacity *= 2;
+    if (capacity > slots_.size())
+      Rehash(capacity);
+  }
+
+  void Clear() {
+    entries_.clear();
+    slots_.clear();
+    mask_ = 0;
+  }
+
+  size_t Size() const { return entries_.size(); }
+  bool Empty() const { return entries_.empty(); }
+
+  iterator begin() { return entries_.begin(); }
+  iterator end() { return entries_.end(); }
+  const_iterator begin() const { return entries_.begin(); }
+  const_iterator end() const { return entries_.end(); }
+
+private:
+  struct Slot {
+    int32_t index;  // Position in |entries_|, -1 if slot is empty.
+    uint32_t hash;
+  };
+
+  // FNV-1a over the symbol characters.
+  static uint32_t Hash(const wchar_t* symbol) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < kSymbolSize - 1 && symbol[i]; i++) {
+      hash ^= static_cast<uint32_t>(symbol[i]);
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+
+  int32_t FindIndex(const wchar_t* symbol, uint32_t hash) const {
+    if (slots_.empty())
+      return -1;
+    for (size_t pos = hash & mask_;; pos = (pos + 1) & mask_) {
+      const Slot& slot = slots_[pos];
+      if (slot.index < 0)
+        return -1;
+      if (slot.hash == hash &&
+          std::wcsncmp(entries_[slot.index].symbol, symbol, kSymbolSize - 1) == 0)
+        return slot.index;
+    }
+  }
+
+  void Place(uint32_t hash, int32_t index) {
+    size_t pos = hash & mask_;
+    while (slots_[pos].index >= 0)
+      pos = (pos + 1) & mask_;
+    slots_[pos].index = index;
+    slots_[pos].hash = hash;
+  }
+
+  void Rehash(size_t capacity) {
+    slots_.assign(capacity, Slot{ -1, 0 });
+    mask_ = capacity - 1;
+    for (size_t i = 0; i < entries_.size(); i++)
+      Place(Hash(entries_[i].symbol), static_cast<int32_t>(i));
+  }
+
+  // Symbols with their values, in insertion order.
+  std::vector<Entry> entries_;
+  // Open addressing index, size is a power of 2.
+  std::vector<Slot> slots_;
+  size_t mask_;
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Results of the fake ticks of a symbol added by IMTServerAPI::TickAdd:
+// ticks accepted and ticks rejected per result code. Counters are plain
+// atomics written by one thread, the AddRate thread, with relaxed loads
+// and stores, so counting costs no locked instruction; any thread reads
+// them without locking.
+// Rejection codes are kept in a few slots claimed in order of appearance,
+// codes beyond them are counted together in the last slot, marked as
+// other codes.
+// Ex:
+//    TickAddCounters counters;
+//    counters.Add(server->TickAdd(tick));  // AddRate thread.
+//    counters.Rejected() ...               // Any thread.
+class TickAddCounters {
+public:
+  // Rejection codes counted separately.
+  static const size_t kCodes = 4;
+
+  struct Count {
+    // Not set if |other|.
+    MTAPIRES code = MT_RET_OK;
+    // Counts of codes which found no slot of their own.
+    bool other = false;
+    UINT64 count = 0;
+  };
+
+  TickAddCounters() : accepted_(0), rejected_(0), codes_(0) {}
+
+  // Copies are only used while building containers, they are not atomic
+  // with respect to |Add| on |other|.
+  TickAddCounters(const TickAddCounters& other) : TickAddCounters() { *this = other; }
+  TickAddCounters& operator=(const TickAddCounters& other) {
+    size_t used = other.codes_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < used; i++) {
+      slots_[i].code = other.slots_[i].code;
+      slots_[i].other = other.slots_[i].other;
+      slots_[i].count.store(other.slots_[i].count.load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+    }
+    accepted_.store(other.Accepted(), std::memory_order_relaxed);
+    rejected_.store(other.Rejected(), std::memory_order_relaxed);
+    codes_.store(used, std::memory_order_release);
+    return *this;
+  }
+
+  // Count result |res| of a TickAdd call. Return the number of ticks
+  // rejected so far.
+  UINT64 Add(MTAPIRES res) {
+    if (res == MT_RET_OK) {
+      Increment(accepted_);
+      return rejected_.load(std::memory_order_relaxed);
+    }
+    Increment(Slot(res).count);
+    return Increment(rejected_);
+  }
+
+  UINT64 Accepted() const { return accepted_.load(std::memory_order_relaxed); }
+  UINT64 Rejected() const { return rejected_.load(std::memory_order_relaxed); }
+
+  // Append rejection counts per code to |counts|. Counts of a concurrent
+  // |Add| may be seen or not, each of them is consistent.
+  void Rejections(std::vector<Count>& counts) const {
+    size_t used = codes_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < used; i++) {
+      Count count;
+      count.code = slots_[i].code;
+      count.other = slots_[i].other;
+      count.count = slots_[i].count.load(std::memory_order_relaxed);
+      counts.push_back(count);
+    }
+  }
+
+  // Add |counts| of a symbol to |totals| of several symbols, per code.
+  static void Merge(std::vector<Count>& totals, const std::vector<Count>& counts) {
+    for (auto& count : counts) {
+      auto it = std::find_if(totals.begin(), totals.end(), [&](const Count& total) {
+        return total.other == count.other && total.code == count.code;
+      });
+      if (it == totals.end())
+        totals.push_back(count);
+      else
+        it->count += count.count;
+    }
+  }
+
+private:
+  struct CodeSlot {
+    MTAPIRES code = MT_RET_OK;
+    bool other = false;
+    std::atomic<UINT64> count{ 0 };
+  };
+
+  // Single writer: no read-modify-write is needed.
+  static UINT64 Increment(std::atomic<UINT64>& counter) {
+    UINT64 value = counter.load(std::memory_order_relaxed) + 1;
+    counter.store(value, std::memory_order_relaxed);
+    return value;
+  }
+
+  // Slot of rejection code |res|, claimed if it has none. The code is
+  // written before the slot is published by |codes_|.
+  CodeSlot& Slot(MTAPIRES res) {
+    size_t used = codes_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < used; i++) {
+      if (slots_[i].code == res && !slots_[i].other)
+        return slots_[i];
+    }
+    if (used == kCodes)
+      return slots_[kCodes - 1];
+    // The last free slot collects all remaining codes.
+    if (used == kCodes - 1)
+      slots_[used].other = true;
+    else
+      slots_[used].code = res;
+    codes_.store(used + 1, std::memory_order_release);
+    return slots_[used];
+  }
+
+  std::atomic<UINT64> accepted_;
+  std::atomic<UINT64> rejected_;
+  // Slots in use, from the first one.
+  std::atomic<size_t> codes_;
+  CodeSlot slots_[kCodes];
+};
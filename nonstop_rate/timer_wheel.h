@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Hierarchical timing wheel, as used by the Linux kernel timers.
+// Time is divided into ticks of |resolution| milliseconds. Level 0 has one
+// slot per tick for the next 64 ticks, every upper level covers 64 times
+// the range of the level below with the same number of slots; entries are
+// moved down a level when the wheel reaches their slot. Scheduling is O(1)
+// and |Advance| only touches due entries and entries moved down.
+// Entries cannot be cancelled: owners keep the deadline they expect and
+// ignore stale entries when they expire.
+// Not thread-safe, it is owned by one thread.
+// Ex:
+//    TimerWheel<Symbol*> wheel(now_ms, 5);
+//    wheel.Schedule(now_ms + 3000, symbol);
+//    wheel.Advance(now_ms, [&](INT64 deadline, Symbol* symbol) { ... });
+template<typename T>
+class TimerWheel {
+public:
+  TimerWheel(int64_t now_ms, int64_t resolution)
+      : resolution_(resolution > 0 ? resolution : 1),
+        current_tick_(now_ms / resolution_),
+        size_(0) {
+    for (auto& level : slots_)
+      level.resize(kSlots);
+  }
+
+  // Call expire callback for |value| at |deadline_ms| (or at the next tick
+  // if it is already passed). Deadlines further than the wheel range expire
+  // at the end of the range.
+  void Schedule(int64_t deadline_ms, T value) {
+    int64_t tick = (deadline_ms + resolution_ - 1) / resolution_;
+    if (tick <= current_tick_)
+      tick = current_tick_ + 1;
+    if (tick - current_tick_ >= kRange)
+      tick = current_tick_ + kRange - 1;
+    Place(Entry{ tick, deadline_ms, std::move(value) });
+    size_++;
+  }
+
+  // Move the wheel to |now_ms|, calling |expire(deadline_ms, T&)| for every
+  // due entry. |expire| may schedule new entries.
+  template<typename ExpireT>
+  void Advance(int64_t now_ms, ExpireT expire) {
+    int64_t target = now_ms / resolution_;
+    while (current_tick_ < target) {
+      current_tick_++;
+      Cascade();
+
+      // Entries scheduled by |expire| always go to later slots.
+      expired_.swap(slots_[0][current_tick_ & kSlotMask]);
+      size_ -= expired_.size();
+      for (auto& entry : expired_)
+        expire(entry.deadline, entry.value);
+      expired_.clear();
+    }
+  }
+
+  // Number of scheduled entries.
+  size_t Size() const { return size_; }
+
+  // Earliest time (milliseconds) at which |Advance| may expire an entry,
+  // or -1 if there is none. Entries of upper levels count at the time they
+  // are moved down, which is never after their deadline, so an owner may
+  // sleep until then.
+  int64_t NextDeadline() const {
+    if (size_ == 0)
+      return -1;
+    int64_t next = -1;
+    for (int level = 0; level < kLevels; level++) {
+      int shift = kSlotBits * level;
+      int64_t base = current_tick_ >> shift;
+      // Slots of a level in time order, the current one holds the entries
+      // a full turn ahead.
+      for (int64_t offset = 1; offset <= kSlots; offset++) {
+        if (slots_[level][(base + offset) & kSlotMask].empty())
+          continue;
+        int64_t tick = (base + offset) << shift;
+        if (next < 0 || tick < next)
+          next = tick;
+        break;
+      }
+    }
+    return next < 0 ? -1 : next * resolution_;
+  }
+
+  int64_t Resolution() const { return resolution_; }
+
+private:
+  static constexpr int kSlotBits = 6;
+  static constexpr int kSlots = 1 << kSlotBits;
+  static constexpr int kSlotMask = kSlots - 1;
+  static constexpr int kLevels = 4;
+  // Number of ticks covered by the wheel.
+  static constexpr int64_t kRange = 1LL << (kSlotBits * kLevels);
+
+  struct Entry {
+    int64_t tick;
+    int64_t deadline;
+    T value;
+  };
+
+  void Place(Entry&& entry) {
+    int64_t delta = entry.tick - current_tick_;
+    int level = 0;
+    while (level + 1 < kLevels && delta >= (1LL << (kSlotBits * (level + 1))))
+      level++;
+    size_t slot = (entry.tick >> (kSlotBits * level)) & kSlotMask;
+    slots_[level][slot].push_back(std::move(entry));
+  }
+
+  // When the wheel enters a new slot of an upper level, spread that slot
+  // over the levels below it.
+  void Cascade() {
+    for (int level = 1; level < kLevels; level++) {
+      if (current_tick_ & ((1LL << (kSlotBits * level)) - 1))
+        break;
+      size_t slot = (current_tick_ >> (kSlotBits * level)) & kSlotMask;
+      cascaded_.swap(slots_[level][slot]);
+      for (auto& entry : cascaded_)
+        Place(std::move(entry));
+      cascaded_.clear();
+    }
+  }
+
+  const int64_t resolution_;
+  // Last processed tick.
+  int64_t current_tick_;
+  size_t size_;
+  std::vector<std::vector<Entry>> slots_[kLevels];
+  // Buffers reused by |Advance|, so a steady wheel does not allocate.
+  std::vector<Entry> expired_;
+  std::vector<Entry> cascaded_;
+};
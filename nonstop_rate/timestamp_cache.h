@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+// Local time formatter for log records: "YYYY-mm-dd HH:MM:SS.mmm".
+// Each thread keeps the text of the last second it formatted, so the
+// calendar conversion only runs when the second changes and the other
+// records of that second only get their milliseconds written.
+// Uses localtime_r/localtime_s, never the shared buffer of std::localtime.
+// Ex:
+//    CharT text[TimestampCache<CharT>::kLength];
+//    size_t length = TimestampCache<CharT>::Format(system_clock::now(), text);
+template<typename CharT>
+class TimestampCache {
+public:
+  // Length of the formatted time, without terminating zero.
+  static const size_t kLength = 23;
+
+  // Write local |time| to |text| (at least kLength characters), return
+  // number of written characters.
+  static size_t Format(std::chrono::system_clock::time_point time, CharT* text) {
+    using namespace std::chrono;
+    int64_t msc = duration_cast<milliseconds>(time.time_since_epoch()).count();
+    int64_t second = msc / 1000;
+    int millisecond = static_cast<int>(msc % 1000);
+    if (millisecond < 0) {
+      second--;
+      millisecond += 1000;
+    }
+
+    static thread_local Cache cache;
+    if (!cache.valid || cache.second != second)
+      cache.Render(second);
+
+    for (size_t i = 0; i < kSecondLength; i++)
+      text[i] = cache.text[i];
+    text[kSecondLength] = CharT('.');
+    WriteDigits(text + kSecondLength + 1, millisecond, 3);
+    return kLength;
+  }
+
+private:
+  // Length of "YYYY-mm-dd HH:MM:SS".
+  static const size_t kSecondLength = 19;
+
+  struct Cache {
+    bool valid = false;
+    int64_t second = 0;
+    CharT text[kSecondLength];
+
+    void Render(int64_t new_second) {
+      std::time_t time = static_cast<std::time_t>(new_second);
+      std::tm tm_time;
+#ifdef _WIN32
+      localtime_s(&tm_time, &time);
+#else
+      localtime_r(&time, &tm_time);
+#endif
+      WriteDigits(text, tm_time.tm_year + 1900, 4);
+      text[4] = CharT('-');
+      WriteDigits(text + 5, tm_time.tm_mon + 1, 2);
+      text[7] = CharT('-');
+      WriteDigits(text + 8, tm_time.tm_mday, 2);
+      text[10] = CharT(' ');
+      WriteDigits(text + 11, tm_time.tm_hour, 2);
+      text[13] = CharT(':');
+      WriteDigits(text + 14, tm_time.tm_min, 2);
+      text[16] = CharT(':');
+      WriteDigits(text + 17, tm_time.tm_sec, 2);
+      second = new_second;
+      valid = true;
+    }
+  };
+
+  // Write |value| as exactly |width| decimal digits.
+  static void WriteDigits(CharT* text, int value, int width) {
+    for (int i = width - 1; i >= 0; i--) {
+      text[i] = static_cast<CharT>(CharT('0') + value % 10);
+      value /= 10;
+    }
+  }
+};